@@ -0,0 +1,534 @@
+/**
+	@file
+	sc.util.apen.bench - timing of the sc.apen core over a grid of series, checked against the original calculation
+	Connor Rawls - cwrawls@asu.edu
+
+    Copyright Synthesis Center, Arizona State University, 2018
+
+	@ingroup    analysis-utilities
+*/
+
+/* usage: sc_apen_bench [largest series_length] [repeats]
+
+ For every signal, series_length (128 up to the largest, doubling), pattern_length and similarity this prints
+ the cost of a full calculation, of a list of SC_UTIL_APEN_BENCH_LIST values and of a dump, each in ns per call.
+ The similarity is given as a fraction of the signal's standard deviation, as it is usually chosen.
+
+ ref is the calculation sc.apen started from, comparing every ordered pair of windows at both sizes.
+ Its pairs/op and elements/op count the window pairs and element distances it looks at,
+ calc pairs/op is the number of window pairs the core compared for the same value.
+ repeat is a calculation with nothing changed since the last one, answered from the cached result.
+ est is a calculation sampling SC_UTIL_APEN_BENCH_SAMPLES reference windows, est err its distance from the exact value
+ in units of its own 95% confidence interval half-width (values up to 1 are inside the interval).
+ Every calculation must give exactly the ApEn value of ref, and the match counts of the scalar and
+ SIMD comparisons must be identical, and the r of relative similarity must follow the standard deviation
+ of the series, otherwise the line is marked and the exit status is 1.
+ After the table, lowering pattern_length on a series that has slid through its counts must also give the value of ref,
+ and the counts kept on input must equal a fresh count while values, lists, pattern_length and vector_size change.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>                        // QueryPerformanceCounter
+#else
+#include <time.h>                           // clock_gettime
+#endif
+
+#include "sc.util.apen.core.h"
+
+#define SC_UTIL_APEN_BENCH_LIST 64          // number of values in each list sent to the series
+#define SC_UTIL_APEN_BENCH_SAMPLES 64       // number of reference windows sampled by the estimate timing
+
+////////////////////////// counters kept by the reference calculation
+typedef struct _sc_util_apen_bench_count
+{
+    double                  pairs;                      //number of window pairs compared
+    double                  elements;                   //number of element distances calculated
+} t_sc_util_apen_bench_count;
+
+double sc_util_apen_bench_now(void); //monotonic time in ns
+double sc_util_apen_bench_random(unsigned long* state); //uniform value in [0, 1), repeatable from the seed
+void sc_util_apen_bench_signal(long type, double* d, long length); //fills d with white noise, a sine, a random walk or whole number codes
+double sc_util_apen_bench_sd(double* d, long length); //standard deviation of the signal
+double sc_util_apen_bench_maxdist(double* d0, double* d1, long l, double r, t_sc_util_apen_bench_count* count);
+double sc_util_apen_bench_reference(double* d, long length, long m, double r, t_sc_util_apen_bench_count* count); //ApEn as sc.apen first calculated it
+long sc_util_apen_bench_simd_check(double* d, long length, long m, double r); //returns 1 if the scalar and SIMD comparisons give the same counts
+long sc_util_apen_bench_shrink_check(long type, long length); //returns 1 if lowering pattern_length after a full series has slid through gives the value of ref
+long sc_util_apen_bench_counts_check(t_sc_util_apen_core* core, double* copy, long* fresh); //returns 1 if the counts kept on input are valid and equal a fresh count of the series
+long sc_util_apen_bench_incremental_check(long type, long length); //returns 1 if the counts kept on input match fresh counts through pattern_length and vector_size changes
+long sc_util_apen_bench_snapshot_check(long type, long length); //returns 1 if a snapshot of a slid series calculates the values of the series itself
+long sc_util_apen_bench_estimate_check(long type, long length); //returns 1 if estimate gives the same value on a fresh series and after a pattern_length change
+
+static const char* sc_util_apen_bench_signals[] = {"noise", "sine", "walk", "codes"};
+
+double sc_util_apen_bench_now(void) {
+#ifdef _WIN32
+    LARGE_INTEGER count, frequency;
+    QueryPerformanceCounter(&count);
+    QueryPerformanceFrequency(&frequency);
+    return (double)count.QuadPart * 1e9 / (double)frequency.QuadPart;
+#else
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (double)t.tv_sec * 1e9 + (double)t.tv_nsec;
+#endif
+}
+
+double sc_util_apen_bench_random(unsigned long* state) {
+    //xorshift, the same series on every machine for a given seed
+    unsigned long s = *state & 0xffffffffUL;
+    s ^= (s << 13) & 0xffffffffUL;
+    s ^= s >> 17;
+    s ^= (s << 5) & 0xffffffffUL;
+    *state = s;
+    return (double)s / 4294967296.0;
+}
+
+void sc_util_apen_bench_signal(long type, double* d, long length) {
+    unsigned long state = 2463534242UL;
+    double walk = 0.0;
+    long code = 3;
+
+    for(long t = 0; t < length; t++) {
+        double noise = sc_util_apen_bench_random(&state) * 2.0 - 1.0;
+        switch(type) {
+            case 1:
+                //slow sine with a little noise so not every window repeats exactly
+                d[t] = sin(t * 0.05) + noise * 0.05;
+                break;
+            case 2:
+                walk += noise;
+                d[t] = walk;
+                break;
+            case 3:
+                //states 0 to 7 stepping up or down now and then, counted by the hash table while r < 1
+                if(noise > 0.6 && code < 7) {
+                    code++;
+                } else if(noise < -0.6 && code > 0) {
+                    code--;
+                }
+                d[t] = code;
+                break;
+            default:
+                d[t] = noise;
+                break;
+        }
+    }
+}
+
+double sc_util_apen_bench_sd(double* d, long length) {
+    double mean = 0.0;
+    double var = 0.0;
+
+    for(long t = 0; t < length; t++) {
+        mean += d[t];
+    }
+    mean /= length;
+    for(long t = 0; t < length; t++) {
+        var += (d[t] - mean) * (d[t] - mean);
+    }
+    return sqrt(var / length);
+}
+
+//sc_util_apen_maxdist, counting the element distances it calculates
+double sc_util_apen_bench_maxdist(double* d0, double* d1, long l, double r, t_sc_util_apen_bench_count* count) {
+    double md = 0.0;
+
+    count->pairs++;
+    for(int i = 0; i < l; i++) {
+        double dist = fabs(d1[i] - d0[i]);
+        count->elements++;
+        md = (dist > md) ? dist : md;
+        if(md > r) {
+            return md;
+        }
+    }
+    return md;
+}
+
+//the original two pass calculation, every ordered pair of windows at pattern_length and then at pattern_length + 1
+double sc_util_apen_bench_reference(double* d, long length, long m, double r, t_sc_util_apen_bench_count* count) {
+    double avg_ratio[2] = {0.0, 0.0};
+
+    for(int k = 0; k < 2; k++) {
+        long l = m + k;
+        long n = length - l + 1;
+        for(int i = 0; i < n; i++) {
+            double ratio = 0.0;
+            for(int j = 0; j < n; j++) {
+                ratio += (sc_util_apen_bench_maxdist(d + i, d + j, l, r, count) <= r) ? 1 : 0;
+            }
+            ratio /= n;
+            avg_ratio[k] += ratio;
+        }
+        avg_ratio[k] /= n;
+    }
+    return log(avg_ratio[0] / ((avg_ratio[1] > 0.0) ? avg_ratio[1] : 0.0000001));
+}
+
+long sc_util_apen_bench_simd_check(double* d, long length, long m, double r) {
+    long n0 = length - m + 1;
+    long* c0 = (long*)malloc(sizeof(long) * n0 * 4);
+    long* c1 = c0 + n0;
+    long* s0 = c0 + 2 * n0;
+    long* s1 = c0 + 3 * n0;
+    t_sc_util_apen_match_block fastest = sc_util_apen_match_block;
+    long same = 1;
+
+    sc_util_apen_count_pairs(d, length, 1, length, m, r, c0, c1);
+    sc_util_apen_match_block = sc_util_apen_match_block_scalar;
+    sc_util_apen_count_pairs(d, length, 1, length, m, r, s0, s1);
+    sc_util_apen_match_block = fastest;
+
+    for(long i = 0; i < n0; i++) {
+        if(c0[i] != s0[i] || (i < n0 - 1 && c1[i] != s1[i])) {
+            same = 0;
+            break;
+        }
+    }
+    free(c0);
+    return same;
+}
+
+//slides a full series of length values through the counts until count_head is as far along as it goes, then lowers pattern_length from 4 to 2
+/* The shorter pattern has more windows than fit after that count_head, so the counts must start again from the beginning of their arrays. */
+long sc_util_apen_bench_shrink_check(long type, long length) {
+    long slide = length + 3;
+    double* d = (double*)malloc(sizeof(double) * (length + slide));
+    double* copy = (double*)malloc(sizeof(double) * length);
+    t_sc_util_apen_core core;
+    t_sc_util_apen_bench_count count = {0.0, 0.0};
+    double result[3];
+    long same = 0;
+    
+    if(d && copy && sc_util_apen_core_init(&core, length, 1)) {
+        sc_util_apen_bench_signal(type, d, length + slide);
+        double r = 0.2 * sc_util_apen_bench_sd(d, length);
+        sc_util_apen_core_set_pattern_length(&core, 4);
+        sc_util_apen_core_set_similarity(&core, r);
+        sc_util_apen_core_append_list(&core, d, length);
+        sc_util_apen_core_calculate(&core, SC_UTIL_APEN_MODE_APEN, 1, result);
+        for(long i = 0; i < slide; i++) {
+            sc_util_apen_core_append(&core, d + length + i);
+        }
+        sc_util_apen_core_set_pattern_length(&core, 2);
+        sc_util_apen_core_calculate(&core, SC_UTIL_APEN_MODE_APEN, 1, result);
+        sc_util_apen_core_copy(&core, copy);
+        same = (result[0] == sc_util_apen_bench_reference(copy, length, 2, r, &count));
+        sc_util_apen_core_free(&core);
+    }
+    free(d);
+    free(copy);
+    return same;
+}
+
+long sc_util_apen_bench_counts_check(t_sc_util_apen_core* core, double* copy, long* fresh) {
+    long length = core->series_length;
+    long m = core->pattern_length;
+    long n0 = length - m + 1;
+    long* c0 = core->match_count0 + core->count_head;
+    long* c1 = core->match_count1 + core->count_head;
+    
+    if(!core->counts_valid) {
+        //only a series too short to calculate may be waiting for its first count
+        return length < m * 2;
+    }
+    if(n0 < 1) {
+        return 1;
+    }
+    sc_util_apen_core_copy(core, copy);
+    sc_util_apen_count_all(copy, length, core->series_vector_size, length, m, core->similarity, fresh, fresh + n0, NULL);
+    for(long i = 0; i < n0; i++) {
+        if(c0[i] != fresh[i] || (i < n0 - 1 && c1[i] != fresh[n0 + i])) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+//follows the counts kept by sc_util_apen_core_append through single values, short lists, the series filling up and sliding
+/* pattern_length goes from 3 down to 2 and up to 4, then vector_size goes to 2 and back to 1, each followed by
+ more than a full series of input so count_head moves all the way along the count arrays and back.
+ A calculation is made whenever the counts are not kept, as calculate_on_input does, and the counts
+ are compared with a fresh count every few values.
+ */
+long sc_util_apen_bench_incremental_check(long type, long length) {
+    long input = 12 * length;
+    double* d = (double*)malloc(sizeof(double) * input * 2);
+    double* copy = (double*)malloc(sizeof(double) * length * 2);
+    long* fresh = (long*)malloc(sizeof(long) * length * 2);
+    long phases[][2] = {{3, 1}, {2, 1}, {4, 1}, {4, 2}, {2, 1}}; //pattern_length and vector_size of each phase
+    t_sc_util_apen_core core;
+    double result[3];
+    long used = 0;
+    long same = 0;
+    
+    if(d && copy && fresh && sc_util_apen_core_init(&core, length, 1)) {
+        sc_util_apen_bench_signal(type, d, input * 2);
+        sc_util_apen_core_set_similarity(&core, 0.2 * sc_util_apen_bench_sd(d, length));
+        sc_util_apen_core_append_list(&core, d, length);
+        used = length;
+        same = 1;
+        
+        for(unsigned long p = 0; same && p < sizeof(phases) / sizeof(phases[0]); p++) {
+            long dims = phases[p][1];
+            if(!sc_util_apen_core_set_vector_size(&core, dims)) {
+                same = 0;
+                break;
+            }
+            sc_util_apen_core_set_pattern_length(&core, phases[p][0]);
+            
+            for(long i = 0; same && i < length + length / 2; ) {
+                //single values, then a short list of a few
+                long count = (i % 3) ? 1 : 5;
+                //counts are started by a calculation, from then on they follow the input
+                if(!core.counts_valid) {
+                    sc_util_apen_core_calculate(&core, SC_UTIL_APEN_MODE_APEN, 1, result);
+                }
+                sc_util_apen_core_append_list(&core, d + used * dims, count);
+                used += count;
+                i += count;
+                if(i % 7 < count) {
+                    same = sc_util_apen_bench_counts_check(&core, copy, fresh);
+                }
+            }
+            same = same && sc_util_apen_bench_counts_check(&core, copy, fresh);
+        }
+        sc_util_apen_core_free(&core);
+    }
+    free(d);
+    free(copy);
+    free(fresh);
+    return same;
+}
+
+//slides a series of 2 dimensions half way around its ring, then calculates every mode on a snapshot and on the series
+/* The snapshot is made once with the counts kept on input and once after they were dropped, as the worker of sc.apen finds them. */
+long sc_util_apen_bench_snapshot_check(long type, long length) {
+    long input = length + length / 2;
+    double* d = (double*)malloc(sizeof(double) * input * 2);
+    t_sc_util_apen_core core;
+    t_sc_util_apen_core snapshot;
+    double result[3 * SC_UTIL_APEN_MAX_SCALES];
+    double expected[3 * SC_UTIL_APEN_MAX_SCALES];
+    long same = 0;
+    
+    if(!d || !sc_util_apen_core_init(&core, length, 2)) {
+        free(d);
+        return 0;
+    }
+    if(sc_util_apen_core_init(&snapshot, length, 2)) {
+        sc_util_apen_bench_signal(type, d, input * 2);
+        sc_util_apen_core_set_similarity(&core, 0.2 * sc_util_apen_bench_sd(d, input * 2));
+        sc_util_apen_core_set_pattern_length(&core, 2);
+        sc_util_apen_core_append_list(&core, d, length);
+        sc_util_apen_core_calculate(&core, SC_UTIL_APEN_MODE_APEN, 1, result);
+        sc_util_apen_core_append_list(&core, d + length * 2, input - length);
+        same = 1;
+        
+        for(long dropped = 0; same && dropped < 2; dropped++) {
+            if(dropped) {
+                sc_util_apen_core_changed(&core);
+            }
+            for(long mode = SC_UTIL_APEN_MODE_APEN; same && mode <= SC_UTIL_APEN_MODE_ALL; mode++) {
+                sc_util_apen_core_snapshot(&core, &snapshot);
+                sc_util_apen_core_calculate(&snapshot, mode, 2, result);
+                sc_util_apen_core_calculate(&core, mode, 2, expected);
+                same = (memcmp(result, expected, sizeof(double) * 3 * 2) == 0);
+            }
+        }
+        sc_util_apen_core_free(&snapshot);
+    }
+    sc_util_apen_core_free(&core);
+    free(d);
+    return same;
+}
+
+//calculates the same series with estimate set, once as it was filled and once after pattern_length went to 2 and back
+/* Both have incremental on and start counting on the first values, which keeps the counts of the first one valid
+ as it fills and drops those of the second, so a value that depended on the counts kept would be exact in one and sampled in the other.
+ */
+long sc_util_apen_bench_estimate_check(long type, long length) {
+    double* d = (double*)malloc(sizeof(double) * length);
+    t_sc_util_apen_core fresh;
+    t_sc_util_apen_core changed;
+    double result[3];
+    double expected[3];
+    long same = 0;
+    
+    if(!d || !sc_util_apen_core_init(&fresh, length, 1)) {
+        free(d);
+        return 0;
+    }
+    if(sc_util_apen_core_init(&changed, length, 1)) {
+        sc_util_apen_bench_signal(type, d, length);
+        double r = 0.2 * sc_util_apen_bench_sd(d, length);
+        sc_util_apen_core_set_similarity(&fresh, r);
+        sc_util_apen_core_set_similarity(&changed, r);
+        //one value at a time, a long list would drop the counts of both
+        for(long i = 0; i < length; i++) {
+            if(i == 6) {
+                //a calculation on the first values starts the counts, estimate is set afterwards
+                sc_util_apen_core_calculate(&fresh, SC_UTIL_APEN_MODE_APEN, 1, result);
+                sc_util_apen_core_calculate(&changed, SC_UTIL_APEN_MODE_APEN, 1, result);
+                sc_util_apen_core_set_estimate(&fresh, SC_UTIL_APEN_BENCH_SAMPLES, 1);
+                sc_util_apen_core_set_estimate(&changed, SC_UTIL_APEN_BENCH_SAMPLES, 1);
+            }
+            sc_util_apen_core_append(&fresh, d + i);
+            sc_util_apen_core_append(&changed, d + i);
+        }
+        
+        sc_util_apen_core_calculate(&fresh, SC_UTIL_APEN_MODE_COMBINED, 1, expected);
+        sc_util_apen_core_set_pattern_length(&changed, 2);
+        sc_util_apen_core_calculate(&changed, SC_UTIL_APEN_MODE_COMBINED, 1, result);
+        sc_util_apen_core_set_pattern_length(&changed, 3);
+        sc_util_apen_core_calculate(&changed, SC_UTIL_APEN_MODE_COMBINED, 1, result);
+        same = (result[0] == expected[0] && result[1] == expected[1]);
+        sc_util_apen_core_free(&changed);
+    }
+    sc_util_apen_core_free(&fresh);
+    free(d);
+    return same;
+}
+
+int main(int argc, char** argv) {
+    long largest = (argc > 1) ? atol(argv[1]) : 4096;
+    long repeats = (argc > 2) ? atol(argv[2]) : 5;
+    long pattern_lengths[] = {2, 3};
+    double similarities[] = {0.1, 0.2, 0.5};
+    long failed = 0;
+
+    if(largest < 128 || repeats < 1) {
+        fprintf(stderr, "usage: %s [largest series_length >= 128] [repeats >= 1]\n", argv[0]);
+        return 2;
+    }
+
+    sc_util_apen_match_block = sc_util_apen_select_match_block();
+
+    double* d = (double*)malloc(sizeof(double) * (largest + SC_UTIL_APEN_BENCH_LIST));
+    double* copy = (double*)malloc(sizeof(double) * largest);
+
+    printf("%-6s %6s %2s %4s %12s %14s %12s %12s %8s %12s %12s %12s %12s %12s %6s\n", "signal", "length", "m", "r", "calc ns/op", "calc pairs/op", "repeat ns/op", "est ns/op", "est err", "ref ns/op", "pairs/op", "elements/op", "list ns/op", "dump ns/op", "check");
+
+    for(long type = 0; type < 4; type++) {
+        for(long length = 128; length <= largest; length *= 2) {
+            sc_util_apen_bench_signal(type, d, length + SC_UTIL_APEN_BENCH_LIST);
+            double sd = sc_util_apen_bench_sd(d, length);
+
+            for(int mi = 0; mi < 2; mi++) {
+                for(int ri = 0; ri < 3; ri++) {
+                    long m = pattern_lengths[mi];
+                    double r = similarities[ri] * sd;
+                    t_sc_util_apen_core core;
+                    t_sc_util_apen_bench_count count = {0.0, 0.0};
+                    double result[3];
+                    double t0 = 0.0;
+
+                    if(!sc_util_apen_core_init(&core, length, 1)) {
+                        fprintf(stderr, "could not allocate a series of length %ld\n", length);
+                        return 2;
+                    }
+                    sc_util_apen_core_set_pattern_length(&core, m);
+                    sc_util_apen_core_set_similarity(&core, r);
+
+                    //counts are recounted on every calculation, as after a bang with incremental off
+                    sc_util_apen_core_set_incremental(&core, 0);
+                    sc_util_apen_core_append_list(&core, d, length);
+                    t0 = sc_util_apen_bench_now();
+                    for(long i = 0; i < repeats; i++) {
+                        sc_util_apen_core_changed(&core);
+                        sc_util_apen_core_calculate(&core, SC_UTIL_APEN_MODE_APEN, 1, result);
+                    }
+                    double calc = (sc_util_apen_bench_now() - t0) / repeats;
+                    double calc_value = result[0];
+                    double calc_pairs = core.stats.comparisons / repeats;
+                    
+                    //bangs with nothing changed in between
+                    t0 = sc_util_apen_bench_now();
+                    for(long i = 0; i < repeats; i++) {
+                        sc_util_apen_core_calculate(&core, SC_UTIL_APEN_MODE_APEN, 1, result);
+                    }
+                    double repeat = (sc_util_apen_bench_now() - t0) / repeats;
+                    long repeat_ok = (result[0] == calc_value);
+                    
+                    //sampled reference windows instead of every window
+                    sc_util_apen_core_set_estimate(&core, SC_UTIL_APEN_BENCH_SAMPLES, 1);
+                    t0 = sc_util_apen_bench_now();
+                    for(long i = 0; i < repeats; i++) {
+                        sc_util_apen_core_changed(&core);
+                        sc_util_apen_core_calculate(&core, SC_UTIL_APEN_MODE_APEN, 1, result);
+                    }
+                    double est = (sc_util_apen_bench_now() - t0) / repeats;
+                    double half = (core.ci[1] - core.ci[0]) / 2;
+                    double est_err = (half > 0.0) ? fabs(result[0] - calc_value) / half : 0.0;
+                    sc_util_apen_core_set_estimate(&core, 0, 1);
+
+                    t0 = sc_util_apen_bench_now();
+                    double reference = sc_util_apen_bench_reference(d, length, m, r, &count);
+                    double ref = sc_util_apen_bench_now() - t0;
+
+                    //lists into a full series, with the counts following the input as calculate_on_input does
+                    sc_util_apen_core_set_incremental(&core, 1);
+                    sc_util_apen_core_calculate(&core, SC_UTIL_APEN_MODE_APEN, 1, result);
+                    t0 = sc_util_apen_bench_now();
+                    for(long i = 0; i < repeats; i++) {
+                        sc_util_apen_core_append_list(&core, d + length - SC_UTIL_APEN_BENCH_LIST + (i & 1) * SC_UTIL_APEN_BENCH_LIST, SC_UTIL_APEN_BENCH_LIST);
+                    }
+                    double list = (sc_util_apen_bench_now() - t0) / repeats;
+
+                    t0 = sc_util_apen_bench_now();
+                    for(long i = 0; i < repeats; i++) {
+                        sc_util_apen_core_copy(&core, copy);
+                    }
+                    double dump = (sc_util_apen_bench_now() - t0) / repeats;
+                    
+                    //r kept by relative mode as more values slide through, against the standard deviation of the series it holds
+                    sc_util_apen_core_set_similarity(&core, similarities[ri]);
+                    sc_util_apen_core_set_similarity_mode(&core, SC_UTIL_APEN_SIMILARITY_RELATIVE);
+                    sc_util_apen_core_append_list(&core, d + 1, SC_UTIL_APEN_BENCH_LIST);
+                    sc_util_apen_core_copy(&core, copy);
+                    double relative_r = similarities[ri] * sc_util_apen_bench_sd(copy, length);
+                    long relative_ok = fabs(core.similarity - relative_r) <= 1e-9 * relative_r;
+                    sc_util_apen_core_free(&core);
+
+                    const char* check = "ok";
+                    if(calc_value != reference || !repeat_ok) {
+                        check = "VALUE";
+                        failed = 1;
+                    } else if(!sc_util_apen_bench_simd_check(d, length, m, r)) {
+                        check = "SIMD";
+                        failed = 1;
+                    } else if(!relative_ok) {
+                        check = "SD";
+                        failed = 1;
+                    }
+
+                    printf("%-6s %6ld %2ld %4.1f %12.0f %14.0f %12.0f %12.0f %8.2f %12.0f %12.0f %12.0f %12.0f %12.0f %6s\n", sc_util_apen_bench_signals[type], length, m, similarities[ri], calc, calc_pairs, repeat, est, est_err, ref, count.pairs, count.elements, list, dump, check);
+                    fflush(stdout);
+                }
+            }
+        }
+    }
+
+    printf("\n");
+    for(long type = 0; type < 4; type++) {
+        long ok = sc_util_apen_bench_shrink_check(type, 512);
+        printf("%-6s pattern_length 4 to 2 after a full series: %s\n", sc_util_apen_bench_signals[type], ok ? "ok" : "VALUE");
+        failed |= !ok;
+        ok = sc_util_apen_bench_incremental_check(type, 256);
+        printf("%-6s counts kept on input through pattern_length and vector_size changes: %s\n", sc_util_apen_bench_signals[type], ok ? "ok" : "COUNTS");
+        failed |= !ok;
+        ok = sc_util_apen_bench_snapshot_check(type, 256);
+        printf("%-6s snapshot of a slid series: %s\n", sc_util_apen_bench_signals[type], ok ? "ok" : "VALUE");
+        failed |= !ok;
+        ok = sc_util_apen_bench_estimate_check(type, 256);
+        printf("%-6s estimate after a pattern_length change: %s\n", sc_util_apen_bench_signals[type], ok ? "ok" : "VALUE");
+        failed |= !ok;
+    }
+
+    free(d);
+    free(copy);
+    return (int)failed;
+}
@@ -10,19 +10,101 @@
 
 #include "ext.h"							// standard Max include, always required
 #include "ext_obex.h"						// required for new style Max object
+#include "ext_buffer.h"                     // reading and writing buffer~ for analyze and read
+#include "ext_dictobj.h"                    // analysis results when no buffer~ is named
+
+#ifdef WIN_VERSION
+#include <windows.h>                        // mapping files for read
+#else
+#include <fcntl.h>                          // mapping files for read
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "sc.util.apen.core.h"             // series storage and calculation, usable without Max
+
+#define SC_UTIL_APEN_MAX_SWEEP 64           // largest number of similarity or pattern_length values in a sweep
+#define SC_UTIL_APEN_MAX_CHANNELS 1024      // largest value of the channels attribute
+#define SC_UTIL_APEN_CHANNEL_RESULT (3 * SC_UTIL_APEN_MAX_SCALES) // values kept per channel in channel_result
 
 ////////////////////////// object struct
 typedef struct _sc_util_apen
 {
 	t_object	            ob;
-    long                    series_length;              //the current size of the array. Must be >= 1 <= series_max_length
-    long                    series_max_length;          //the maximum size of the array, will be assigned a default value
-    long                    series_vector_size;         //the size of the vector held at each point in the series
-    double                  similarity;                 //the thresholding factor when considering the similarity between patterns
-    long                    pattern_length;             //the number of points in the series considered in a single pattern
+    t_sc_util_apen_core     core;                       //the series, its match counts and the parameters they depend on, see sc.util.apen.core.h
     long                    calc_on_input;              //flag to determine if ApEn should be calculated whenever new input is received
     long                    hold_size_warning;          //flag to determine if ApEn should print to the console when there is insufficient data to compute
-    double*                 test_value;                 //holds data series. Will replace with Eigen Array/Matrix when moving to N-D vectors
+    long                    incremental;                //flag to determine if template match counts are kept up to date as data enters and leaves the series
+    long                    hop_size;                   //number of new values needed before calculate_on_input calculates again
+    double                  calc_interval;              //minimum time in ms between calculations triggered by calculate_on_input, 0 for no limit
+    long                    samples_since_calc;         //number of values received since the last calculation
+    double                  last_calc_time;             //scheduler time in ms of the last calculation
+    long                    calc_scheduled;             //flag set while calc_clock is waiting to run a postponed calculation
+    void*                   calc_clock;                 //runs a calculation postponed by calc_interval
+    long                    async;                      //flag to determine if ApEn is calculated on a worker thread and output later
+    long                    mode;                       //which estimators are calculated and output, one of SC_UTIL_APEN_MODE_*
+    long                    scales;                     //number of coarse-grained scales calculated, 1 for the series as it is
+    long                    channels;                   //number of independent series, see sc_util_apen_channel
+    t_sc_util_apen_core*    channel_cores;              //series of channels 2 ... channels, channel 1 is core
+    double*                 channel_result;             //SC_UTIL_APEN_CHANNEL_RESULT values per channel from the last batch
+    double*                 channel_output;             //copy of channel_result handed from the worker to sc_util_apen_worker_output
+    t_atom*                 channel_atoms;              //two lists of the values of every channel, filled in turn so one can go out while the other is made
+    long                    channel_turn;               //which list of channel_atoms is filled next
+    t_atom*                 channel_atoms_retired;      //the channel_atoms replaced last, freed when the next ones replace them
+    t_systhread*            pool;                       //threads sharing the channels of a batch with the thread that started it
+    long                    pool_size;                  //number of threads in pool
+    t_systhread_mutex       pool_mutex;                 //guards the pool_ fields
+    t_systhread_cond        pool_cond;                  //signalled when a batch starts or the pool should quit
+    t_systhread_cond        pool_done_cond;             //signalled when the last channel of a batch is done
+    long                    pool_batch;                 //incremented for every batch so the pool threads can tell a new one started
+    long                    pool_channels;              //number of channels in the batch
+    long                    pool_next;                  //next channel of the batch not yet taken by a thread
+    long                    pool_done;                  //number of channels of the batch finished
+    long                    pool_short;                 //number of channels of the batch too short to calculate
+    long                    pool_mode;                  //mode the batch is calculated for
+    long                    pool_scales;                //scales the batch is calculated for
+    t_sc_util_apen_core*    pool_cores;                 //cores the batch calculates, NULL for the channels themselves
+    double*                 pool_result;                //SC_UTIL_APEN_CHANNEL_RESULT values per channel written by the batch
+    long                    pool_busy;                  //flag set from the start of a batch until its caller has read pool_short, batches wait for each other
+    long                    pool_quit;                  //flag telling the pool threads to exit
+    t_critical              lock;                       //guards core, channel_cores and the stat_ fields between the threads delivering input, the worker and the main thread
+    t_systhread             worker;                     //thread running sc_util_apen_worker, started the first time async is turned on
+    t_systhread_mutex       worker_mutex;               //guards the worker_ fields shared with the worker thread
+    t_systhread_cond        worker_cond;                //signalled when a calculation is requested or the worker should quit
+    long                    worker_pending;             //flag set when a calculation has been requested, requests made while one is running are merged
+    long                    worker_quit;                //flag telling the worker thread to exit
+    double                  worker_result[3 * SC_UTIL_APEN_MAX_SCALES]; //last ApEn, SampEn and FuzzyEn values calculated by the worker, for each scale
+    long                    worker_mode;                //mode worker_result was calculated for
+    long                    worker_scales;              //number of scales in worker_result
+    double                  worker_ci[2 * SC_UTIL_APEN_MAX_SCALES]; //confidence intervals of the ApEn values in worker_result
+    long                    worker_estimate;            //flag set when worker_result was calculated with estimate on
+    long                    worker_channels;            //number of channels in channel_output, 0 when worker_result holds a single series
+    void*                   worker_qelem;               //outputs worker_result from the main thread
+    double*                 worker_series;              //the worker's snapshot of the series, only touched by the worker thread
+    long*                   worker_count0;              //the worker's match counts at pattern_length
+    long*                   worker_count1;              //the worker's match counts at pattern_length + 1
+    long                    worker_capacity;            //number of samples the worker_ arrays can hold
+    long                    worker_dims;                //number of vector dimensions worker_series can hold
+    double*                 worker_scale_buffer;        //the worker's prefix sums and coarse-grained series
+    void*                   worker_work;                //the worker's memory for the counting kernels, sc_util_apen_work_size(worker_capacity, worker_dims) bytes
+    t_sc_util_apen_core*    worker_cores;               //the worker's snapshot of every channel, only touched by the worker and its batches
+    long                    worker_core_count;          //number of cores in worker_cores
+    double*                 worker_channel_result;      //SC_UTIL_APEN_CHANNEL_RESULT values per channel from the worker's last batch
+    void*                   scratch;                    //one block holding list_values and dump_atoms, sized with the series by sc_util_apen_scratch_new
+    void*                   scratch_retired;            //the scratch replaced last, freed when the next one replaces it
+    double*                 list_values;                //values of a list being added, series_max_length * series_vector_size of them
+    t_atom*                 dump_atoms;                 //two lists output by dump, scratch_values + 2 atoms each, filled in turn like channel_atoms
+    long                    dump_turn;                  //which list of dump_atoms is filled next
+    long                    scratch_values;             //number of values list_values holds, series_max_length * series_vector_size
+    t_symbol*               analysis_output;            //name of the buffer~ analyze and read write their results into, empty for a dictionary
+    t_dictionary*           analysis_dict;              //results of the last analyze or read when analysis_output is empty
+    double                  stat_last_time;             //time in ms taken by the last calculation
+    double                  stat_total_time;            //time in ms taken by every calculation since the stats were reset
+    long                    stat_calculations;          //number of calculations since the stats were reset
+    long                    stat_inputs;                //number of int, float and list messages received
+    long                    stat_skipped;               //inputs that did not calculate because hop_size was not reached
+    long                    stat_coalesced;             //calculations merged into one already waiting on calc_clock or the worker
 	void		            *out;                       //outlet
     void*                   out2;                       //dumpout
 } t_sc_util_apen;
@@ -41,13 +123,24 @@ void sc_util_apen_set_series_length(t_sc_util_apen *x, void *attr, long argc, t_
 void sc_util_apen_set_vector_size(t_sc_util_apen *x, void *attr, long argc, t_atom *argv);                       //sets the size of the data vector and clears the list
 void sc_util_apen_pattern_length(t_sc_util_apen *x, void *attr, long argc, t_atom *argv);                        //sets the size of the pattern to be computed
 void sc_util_apen_similarity(t_sc_util_apen *x, void *attr, long argc, t_atom *argv);                           //sets the threshold for pattern similarity
+void sc_util_apen_set_similarity_mode(t_sc_util_apen *x, void *attr, long argc, t_atom *argv);                   //sets whether similarity is r or a multiple of the standard deviation
 void sc_util_apen_calc_on_input(t_sc_util_apen *x, void *attr, long argc, t_atom *argv);                         //sets whether or not to attempt calculating ApEn when a new data point is received
 void sc_util_apen_hold_size_warning(t_sc_util_apen *x, void *attr, long argc, t_atom *argv);                     //sets flag for showing insufficient data warnings
+void sc_util_apen_set_incremental(t_sc_util_apen *x, void *attr, long argc, t_atom *argv);                       //sets whether match counts are updated per sample instead of recomputed
+void sc_util_apen_set_async(t_sc_util_apen *x, void *attr, long argc, t_atom *argv);                             //sets whether ApEn is calculated on a worker thread
+void sc_util_apen_set_mode(t_sc_util_apen *x, void *attr, long argc, t_atom *argv);                              //sets which estimators are calculated
+void sc_util_apen_set_scales(t_sc_util_apen *x, void *attr, long argc, t_atom *argv);                            //sets the number of multiscale entropy scales
+void sc_util_apen_set_estimate(t_sc_util_apen *x, void *attr, long argc, t_atom *argv);                          //sets the number of reference windows sampled, 0 for every window
+void sc_util_apen_set_estimate_seed(t_sc_util_apen *x, void *attr, long argc, t_atom *argv);                     //sets the seed of the sampled windows
+void sc_util_apen_set_hop_size(t_sc_util_apen *x, void *attr, long argc, t_atom *argv);                          //sets the number of new values between calculations
+void sc_util_apen_set_calc_interval(t_sc_util_apen *x, void *attr, long argc, t_atom *argv);                     //sets the minimum time between calculations
+void sc_util_apen_set_channels(t_sc_util_apen *x, void *attr, long argc, t_atom *argv);                          //sets the number of independent series
 
 t_max_err sc_util_apen_notify(t_sc_util_apen *x, t_symbol *s, t_symbol *msg, void *sender, void *data);
 
 //Attribute Getters
 void sc_util_apen_get_similarity(t_sc_util_apen *x, t_object *attr, long *argc, t_atom **argv);
+void sc_util_apen_get_similarity_mode(t_sc_util_apen *x, t_object *attr, long *argc, t_atom **argv);
 void sc_util_apen_get_coi(t_sc_util_apen *x, t_object *attr, long *argc, t_atom **argv);
 void sc_util_apen_get_series_length(t_sc_util_apen *x, t_object *attr, long *argc, t_atom **argv);
 void sc_util_apen_get_cur_size(t_sc_util_apen *x, t_object *attr, long *argc, t_atom **argv);
@@ -55,19 +148,67 @@ void sc_util_apen_set_cur_size(t_sc_util_apen *x, t_object *attr, long *argc, t_
 void sc_util_apen_get_vector_size(t_sc_util_apen *x, t_object *attr, long *argc, t_atom **argv);
 void sc_util_apen_get_pattern_length(t_sc_util_apen *x, t_object *attr, long *argc, t_atom **argv);
 void sc_util_apen_get_size_warning(t_sc_util_apen *x, t_object *attr, long *argc, t_atom **argv);
+void sc_util_apen_get_incremental(t_sc_util_apen *x, t_object *attr, long *argc, t_atom **argv);
+void sc_util_apen_get_async(t_sc_util_apen *x, t_object *attr, long *argc, t_atom **argv);
+void sc_util_apen_get_mode(t_sc_util_apen *x, t_object *attr, long *argc, t_atom **argv);
+void sc_util_apen_get_scales(t_sc_util_apen *x, t_object *attr, long *argc, t_atom **argv);
+void sc_util_apen_get_estimate(t_sc_util_apen *x, t_object *attr, long *argc, t_atom **argv);
+void sc_util_apen_get_estimate_seed(t_sc_util_apen *x, t_object *attr, long *argc, t_atom **argv);
+void sc_util_apen_get_hop_size(t_sc_util_apen *x, t_object *attr, long *argc, t_atom **argv);
+void sc_util_apen_get_calc_interval(t_sc_util_apen *x, t_object *attr, long *argc, t_atom **argv);
+void sc_util_apen_get_channels(t_sc_util_apen *x, t_object *attr, long *argc, t_atom **argv);
 
 
 void sc_util_apen_dump(t_sc_util_apen *x); //Get a list of stored values out the right outlet
 
+//// Offline analysis, never touches the series held by the object
+void sc_util_apen_analyze(t_sc_util_apen *x, t_symbol *s, long argc, t_atom *argv);      //analyze <buffer~> [window] [hop], ApEn over windows of a buffer~
+void sc_util_apen_read(t_sc_util_apen *x, t_symbol *s, long argc, t_atom *argv);         //read <file> [window] [hop], ApEn over windows of a file of 64-bit floats
+long sc_util_apen_analysis_args(t_sc_util_apen *x, long argc, t_atom *argv, long length, long* window, long* hop); //reads the optional window and hop arguments
+void sc_util_apen_analysis_run(t_sc_util_apen *x, double* series, long length, long dims, long stride, long window, long hop); //calculates every window and writes the results
+void sc_util_apen_sweep(t_sc_util_apen *x, t_symbol *s, long argc, t_atom *argv);        //sweep r <values> m <values>, ApEn for every combination out the right outlet
+void sc_util_apen_set_analysis_output(t_sc_util_apen *x, void *attr, long argc, t_atom *argv);
+void sc_util_apen_get_analysis_output(t_sc_util_apen *x, t_object *attr, long *argc, t_atom **argv);
+
 void sc_util_apen_calculate(t_sc_util_apen *x); //function to actually calculate Approximate Entropy
+void sc_util_apen_output(t_sc_util_apen *x, long mode, long scales, double* result); //sends the values mode asks for out the left outlet
+long sc_util_apen_output_atoms(long mode, long scales, double* result, t_atom* list); //fills list with the values mode asks for, returns how many
+void sc_util_apen_output_confidence(t_sc_util_apen *x, long scales, double* ci); //sends the confidence intervals of a sampled calculation out the dumpout
+t_atom* sc_util_apen_channel_list(t_sc_util_apen *x, long channels, long mode, long scales, double* result, long* n); //fills the next list of channel_atoms with the values of every channel, the caller holds lock
+
+//Channels
+t_sc_util_apen_core* sc_util_apen_channel(t_sc_util_apen *x, long c); //the series of channel c, counted from 0
+void sc_util_apen_calculate_channels(t_sc_util_apen *x); //calculates every channel and outputs them as one list
+long sc_util_apen_batch(t_sc_util_apen *x, t_sc_util_apen_core* cores, long channels, double* result, long mode, long scales); //calculates channels cores (the channels themselves if NULL, with lock held) into result with the pool, returns the number of channels too short
+void sc_util_apen_batch_work(t_sc_util_apen *x); //takes channels of the current batch until none are left
+void *sc_util_apen_pool_thread(t_sc_util_apen *x); //thread function, helps with every batch
+void sc_util_apen_pool_start(t_sc_util_apen *x, long size); //starts size pool threads
+void sc_util_apen_pool_stop(t_sc_util_apen *x); //ends the pool threads
+long sc_util_apen_cpu_count(void); //number of processors available
+
+//Worker thread for the async attribute
+void sc_util_apen_request(t_sc_util_apen *x); //ask the worker for a calculation, merged with any request not yet started
+void *sc_util_apen_worker(t_sc_util_apen *x); //thread function, calculates ApEn on a snapshot of the series whenever requested
+long sc_util_apen_worker_alloc(t_sc_util_apen *x); //sizes the snapshot buffers for the series, returns 0 if there is not enough memory
+long sc_util_apen_worker_cores_alloc(t_sc_util_apen *x); //sizes a snapshot core for every channel, returns 0 if there is not enough memory
+void sc_util_apen_worker_cores_free(t_sc_util_apen *x);
+void sc_util_apen_worker_channels(t_sc_util_apen *x); //calculates every channel on snapshots, called by the worker with lock held and returns after leaving it
+void sc_util_apen_worker_publish(t_sc_util_apen *x, long mode, long scales, long estimate, double* result, double* ci); //hands a result to sc_util_apen_worker_output
+void sc_util_apen_worker_output(t_sc_util_apen *x); //qelem function, outputs the worker's result from the main thread
+void sc_util_apen_worker_stop(t_sc_util_apen *x); //ends the worker thread and frees its memory
 
-double sc_util_apen_maxdist(double* d0, double* d1, long l, double r); //get the maximum distance between pattern components
 void sc_util_apen_getstate(t_sc_util_apen* x); //output all values through the dumpout
+void* sc_util_apen_scratch_new(long max_length, long dims); //allocates the block behind list_values and dump_atoms, NULL if there is not enough memory
+void sc_util_apen_scratch_set(t_sc_util_apen *x, void* scratch, long max_length, long dims); //retires the old block and points list_values and dump_atoms into scratch
+void sc_util_apen_stats(t_sc_util_apen *x, t_symbol *s, long argc, t_atom *argv); //output the performance counters through the dumpout, stats reset sets them back to 0
 
 //Functions for inputting new data
 void sc_util_apen_int(t_sc_util_apen *x, long n);
 void sc_util_apen_float(t_sc_util_apen *x, double f);
+void sc_util_apen_frame(t_sc_util_apen *x, t_symbol *s, long argc, t_atom *argv); //frame <values>, one vector for each channel
 void sc_util_apen_list(t_sc_util_apen *x, t_symbol* a, long argc, t_atom *argv);
+void sc_util_apen_input_done(t_sc_util_apen *x, long added); //calculates after input if calculate_on_input, hop_size and calc_interval allow it
+void sc_util_apen_tick(t_sc_util_apen *x); //clock function for calculations postponed by calc_interval
 
 //////////////////////// global class pointer variable
 void *sc_util_apen_class;
@@ -81,6 +222,9 @@ void ext_main(void *r)
 				  0L /* leave NULL!! */, A_GIMME, 0);
 
 	class_addmethod(c, (method)sc_util_apen_bang,			    "bang",                             0);
+    class_addmethod(c, (method)sc_util_apen_analyze,            "analyze",              A_GIMME,    0);
+    class_addmethod(c, (method)sc_util_apen_read,               "read",                 A_GIMME,    0);
+    class_addmethod(c, (method)sc_util_apen_sweep,              "sweep",                A_GIMME,    0);
     class_addmethod(c, (method)sc_util_apen_clear,              "clear",                            0);
     class_addmethod(c, (method)sc_util_apen_dump,               "dump",                             0);
     //class_addmethod(c, (method)sc_util_apen_hold_size_warning,  "size_warning",         A_LONG,     0);
@@ -89,24 +233,30 @@ void ext_main(void *r)
     class_addmethod(c, (method)sc_util_apen_notify,             "notify",               A_CANT,     0);
     class_addmethod(c, (method)sc_util_apen_float,              "float",                A_FLOAT,    0);
     class_addmethod(c, (method)sc_util_apen_getstate,           "getstate",                         0);
+    class_addmethod(c, (method)sc_util_apen_stats,              "stats",                A_GIMME,    0);
     class_addmethod(c, (method)sc_util_apen_list,               "list",                 A_GIMME,    0);
+    class_addmethod(c, (method)sc_util_apen_frame,              "frame",                A_GIMME,    0);
     
     //Symbol versions of attributes we want to be callable from the patcher
-    CLASS_ATTR_LONG(c, "series_length",          0,                      t_sc_util_apen , series_max_length);
+    CLASS_ATTR_LONG(c, "series_length",          0,                      t_sc_util_apen , core.series_max_length);
     CLASS_ATTR_ACCESSORS(c, "series_length", sc_util_apen_get_series_length, sc_util_apen_set_series_length);
     
-    CLASS_ATTR_LONG(c, "current_size",           ATTR_SET_OPAQUE,        t_sc_util_apen, series_length);
+    CLASS_ATTR_LONG(c, "current_size",           ATTR_SET_OPAQUE,        t_sc_util_apen, core.series_length);
     CLASS_ATTR_ACCESSORS(c, "current_size", sc_util_apen_get_cur_size, sc_util_apen_set_cur_size);
     
-    CLASS_ATTR_LONG(c, "vector_size",            0,                      t_sc_util_apen, series_vector_size);
+    CLASS_ATTR_LONG(c, "vector_size",            0,                      t_sc_util_apen, core.series_vector_size);
     CLASS_ATTR_ACCESSORS(c, "vector_size", sc_util_apen_get_vector_size,sc_util_apen_set_vector_size);
     
-    CLASS_ATTR_LONG(c, "pattern_length",         0,                      t_sc_util_apen, pattern_length);
+    CLASS_ATTR_LONG(c, "pattern_length",         0,                      t_sc_util_apen, core.pattern_length);
     CLASS_ATTR_ACCESSORS(c, "pattern_length", sc_util_apen_get_pattern_length, sc_util_apen_pattern_length);
     
-    CLASS_ATTR_DOUBLE(c, "similarity",             0,                      t_sc_util_apen, similarity);
+    CLASS_ATTR_DOUBLE(c, "similarity",             0,                      t_sc_util_apen, core.similarity_factor);
     CLASS_ATTR_ACCESSORS(c, "similarity",        sc_util_apen_get_similarity,       sc_util_apen_similarity);
     
+    CLASS_ATTR_LONG(c, "similarity_mode",        0,                      t_sc_util_apen, core.similarity_mode);
+    CLASS_ATTR_ENUMINDEX(c, "similarity_mode", 0, "absolute relative");
+    CLASS_ATTR_ACCESSORS(c, "similarity_mode", sc_util_apen_get_similarity_mode, sc_util_apen_set_similarity_mode);
+    
     CLASS_ATTR_LONG(c, "calculate_on_input",     0,                      t_sc_util_apen, calc_on_input);
     CLASS_ATTR_STYLE(c, "calculate_on_input",   0,                       "onoff");
     CLASS_ATTR_ACCESSORS(c, "calculate_on_input", sc_util_apen_get_coi, sc_util_apen_calc_on_input);
@@ -115,6 +265,39 @@ void ext_main(void *r)
     CLASS_ATTR_STYLE(c, "size_warning", 0, "onoff");
     CLASS_ATTR_ACCESSORS(c, "size_warning", sc_util_apen_get_size_warning, sc_util_apen_hold_size_warning);
     
+    CLASS_ATTR_LONG(c, "incremental",            0,                      t_sc_util_apen, incremental);
+    CLASS_ATTR_STYLE(c, "incremental", 0, "onoff");
+    CLASS_ATTR_ACCESSORS(c, "incremental", sc_util_apen_get_incremental, sc_util_apen_set_incremental);
+    
+    CLASS_ATTR_LONG(c, "hop_size",               0,                      t_sc_util_apen, hop_size);
+    CLASS_ATTR_ACCESSORS(c, "hop_size", sc_util_apen_get_hop_size, sc_util_apen_set_hop_size);
+    
+    CLASS_ATTR_DOUBLE(c, "calc_interval",        0,                      t_sc_util_apen, calc_interval);
+    CLASS_ATTR_ACCESSORS(c, "calc_interval", sc_util_apen_get_calc_interval, sc_util_apen_set_calc_interval);
+    
+    CLASS_ATTR_LONG(c, "async",                  0,                      t_sc_util_apen, async);
+    CLASS_ATTR_STYLE(c, "async", 0, "onoff");
+    CLASS_ATTR_ACCESSORS(c, "async", sc_util_apen_get_async, sc_util_apen_set_async);
+    
+    CLASS_ATTR_LONG(c, "mode",                   0,                      t_sc_util_apen, mode);
+    CLASS_ATTR_ENUMINDEX(c, "mode", 0, "apen sampen fuzzyen combined all");
+    CLASS_ATTR_ACCESSORS(c, "mode", sc_util_apen_get_mode, sc_util_apen_set_mode);
+    
+    CLASS_ATTR_LONG(c, "scales",                 0,                      t_sc_util_apen, scales);
+    CLASS_ATTR_ACCESSORS(c, "scales", sc_util_apen_get_scales, sc_util_apen_set_scales);
+    
+    CLASS_ATTR_LONG(c, "estimate",               0,                      t_sc_util_apen, core.estimate_samples);
+    CLASS_ATTR_ACCESSORS(c, "estimate", sc_util_apen_get_estimate, sc_util_apen_set_estimate);
+    
+    CLASS_ATTR_LONG(c, "estimate_seed",          0,                      t_sc_util_apen, core.estimate_seed);
+    CLASS_ATTR_ACCESSORS(c, "estimate_seed", sc_util_apen_get_estimate_seed, sc_util_apen_set_estimate_seed);
+    
+    CLASS_ATTR_LONG(c, "channels",               0,                      t_sc_util_apen, channels);
+    CLASS_ATTR_ACCESSORS(c, "channels", sc_util_apen_get_channels, sc_util_apen_set_channels);
+    
+    CLASS_ATTR_SYM(c, "analysis_output",        0,                      t_sc_util_apen, analysis_output);
+    CLASS_ATTR_ACCESSORS(c, "analysis_output", sc_util_apen_get_analysis_output, sc_util_apen_set_analysis_output);
+    
     
 
 	/* you CAN'T call this from the patcher */
@@ -122,6 +305,8 @@ void ext_main(void *r)
 
 	class_register(CLASS_BOX, c);
 	sc_util_apen_class = c;
+    
+    sc_util_apen_match_block = sc_util_apen_select_match_block();
 }
 
 /////function definitions
@@ -129,7 +314,11 @@ void ext_main(void *r)
 void sc_util_apen_assist(t_sc_util_apen *x, void *b, long m, long a, char *s)
 {
 	if (m == ASSIST_INLET) { //inlet
-        sprintf(s, "Inlet %ld: List of size %ld to add data to ApEn series / messages in", a, x->series_vector_size);
+        if(x->channels > 1) {
+            sprintf(s, "Inlet %ld: Channel (1 - %ld) followed by lists of size %ld, frame of one vector per channel / messages in", a, x->channels, x->core.series_vector_size);
+        } else {
+            sprintf(s, "Inlet %ld: List of size %ld to add data to ApEn series / messages in", a, x->core.series_vector_size);
+        }
 	}
 	else {	// outlet
         if(a == 0) {
@@ -142,20 +331,44 @@ void sc_util_apen_assist(t_sc_util_apen *x, void *b, long m, long a, char *s)
 
 void sc_util_apen_free(t_sc_util_apen *x)
 {
-    critical_enter(0);
+    if(x->calc_clock) {
+        clock_unset(x->calc_clock);
+        object_free(x->calc_clock);
+        x->calc_clock = NULL;
+    }
+    sc_util_apen_worker_stop(x);
+    sc_util_apen_pool_stop(x);
     sc_util_apen_clear(x);
-    //start by freeing the test values
-    if(x->test_value) {
-        double* temp = x->test_value;
-        temp++;
-        for(int i = 1; i < x->series_max_length && temp; i++) {
-            double* t2 = temp;
-            temp++;
-            sysmem_freeptr(t2);
-        }
-        sysmem_freeptr(x->test_value);
+    
+    critical_enter(x->lock);
+    for(long c = 1; c < x->channels; c++) {
+        sc_util_apen_core_free(x->channel_cores + c - 1);
+    }
+    if(x->channel_cores) {
+        sysmem_freeptr(x->channel_cores);
+        sysmem_freeptr(x->channel_result);
+        sysmem_freeptr(x->channel_output);
+        x->channel_cores = NULL;
     }
-    critical_exit(0);
+    if(x->channel_atoms) {
+        sysmem_freeptr(x->channel_atoms);
+        x->channel_atoms = NULL;
+    }
+    if(x->channel_atoms_retired) {
+        sysmem_freeptr(x->channel_atoms_retired);
+        x->channel_atoms_retired = NULL;
+    }
+    sc_util_apen_core_free(&x->core);
+    sc_util_apen_scratch_set(x, NULL, 0, 0);
+    if(x->analysis_dict) {
+        object_free(x->analysis_dict);
+        x->analysis_dict = NULL;
+    }
+    critical_exit(x->lock);
+    critical_free(x->lock);
+    systhread_mutex_free(x->pool_mutex);
+    systhread_cond_free(x->pool_cond);
+    systhread_cond_free(x->pool_done_cond);
 }
 
 
@@ -173,12 +386,12 @@ void sc_util_apen_getstate(t_sc_util_apen* x) {
     //output all attributes
     
     //pattern length
-    void* state = sysmem_newptr(sizeof(t_atom) * 2);
+    t_atom state[2];
     t_atom* pat_list = (t_atom*)state;
     t_atom* pat_temp = pat_list;
     atom_setsym(pat_temp, gensym("pattern_length"));
     pat_temp++;
-    atom_setlong(pat_temp, x->pattern_length);
+    atom_setlong(pat_temp, x->core.pattern_length);
     outlet_list(x->out, gensym("pattern_length"), 2, (t_atom*)state);
     pat_temp = NULL;
     pat_list = NULL;
@@ -187,10 +400,26 @@ void sc_util_apen_getstate(t_sc_util_apen* x) {
     t_atom* sim_list = (t_atom*)state;
     atom_setsym(sim_list, gensym("similarity"));
     sim_list++;
-    atom_setfloat(sim_list, x->similarity);
+    atom_setfloat(sim_list, x->core.similarity_factor);
     outlet_list(x->out, gensym("similarity"), 2, (t_atom*)state);
     sim_list = NULL;
     
+    //similarity mode
+    t_atom* temp_list = (t_atom*)state;
+    atom_setsym(temp_list, gensym("similarity_mode"));
+    temp_list++;
+    atom_setlong(temp_list, x->core.similarity_mode);
+    outlet_list(x->out, gensym("similarity_mode"), 2, (t_atom*)state);
+    
+    //the r calculations use, similarity times the standard deviation of the series in relative mode
+    temp_list = (t_atom*)state;
+    atom_setsym(temp_list, gensym("effective_similarity"));
+    temp_list++;
+    critical_enter(x->lock);
+    atom_setfloat(temp_list, x->core.similarity);
+    critical_exit(x->lock);
+    outlet_list(x->out, gensym("effective_similarity"), 2, (t_atom*)state);
+    
     //calc on input
     t_atom* coi_list = (t_atom*)state;
     atom_setsym(coi_list, gensym("calculate_on_input"));
@@ -200,17 +429,17 @@ void sc_util_apen_getstate(t_sc_util_apen* x) {
     coi_list = NULL;
     
     //max series length
-    t_atom* temp_list = (t_atom*)state;
+    temp_list = (t_atom*)state;
     atom_setsym(temp_list, gensym("series_length"));
     temp_list++;
-    atom_setlong(temp_list, x->series_max_length);
+    atom_setlong(temp_list, x->core.series_max_length);
     outlet_list(x->out, gensym("series_length"), 2, (t_atom*)state);
     
     //current series length
     temp_list = (t_atom*)state;
     atom_setsym(temp_list, gensym("current_size"));
     temp_list++;
-    atom_setlong(temp_list, x->series_length);
+    atom_setlong(temp_list, x->core.series_length);
     outlet_list(x->out, gensym("current_length"), 2, (t_atom*)state);
     
     //size warning
@@ -220,89 +449,267 @@ void sc_util_apen_getstate(t_sc_util_apen* x) {
     atom_setlong(temp_list, x->hold_size_warning);
     outlet_list(x->out, gensym("size_warning"), 2, (t_atom*)state);
     
+    //hop size
+    temp_list = (t_atom*)state;
+    atom_setsym(temp_list, gensym("hop_size"));
+    temp_list++;
+    atom_setlong(temp_list, x->hop_size);
+    outlet_list(x->out, gensym("hop_size"), 2, (t_atom*)state);
+    
+    //calc interval
+    temp_list = (t_atom*)state;
+    atom_setsym(temp_list, gensym("calc_interval"));
+    temp_list++;
+    atom_setfloat(temp_list, x->calc_interval);
+    outlet_list(x->out, gensym("calc_interval"), 2, (t_atom*)state);
+    
+    //async
+    temp_list = (t_atom*)state;
+    atom_setsym(temp_list, gensym("async"));
+    temp_list++;
+    atom_setlong(temp_list, x->async);
+    outlet_list(x->out, gensym("async"), 2, (t_atom*)state);
+    
+    //mode
+    temp_list = (t_atom*)state;
+    atom_setsym(temp_list, gensym("mode"));
+    temp_list++;
+    atom_setlong(temp_list, x->mode);
+    outlet_list(x->out, gensym("mode"), 2, (t_atom*)state);
+    
+    //scales
+    temp_list = (t_atom*)state;
+    atom_setsym(temp_list, gensym("scales"));
+    temp_list++;
+    atom_setlong(temp_list, x->scales);
+    outlet_list(x->out, gensym("scales"), 2, (t_atom*)state);
+    
+    //estimate
+    temp_list = (t_atom*)state;
+    atom_setsym(temp_list, gensym("estimate"));
+    temp_list++;
+    atom_setlong(temp_list, x->core.estimate_samples);
+    outlet_list(x->out, gensym("estimate"), 2, (t_atom*)state);
+    
+    //estimate seed
+    temp_list = (t_atom*)state;
+    atom_setsym(temp_list, gensym("estimate_seed"));
+    temp_list++;
+    atom_setlong(temp_list, (long)x->core.estimate_seed);
+    outlet_list(x->out, gensym("estimate_seed"), 2, (t_atom*)state);
+    
+    //analysis output
+    temp_list = (t_atom*)state;
+    atom_setsym(temp_list, gensym("analysis_output"));
+    temp_list++;
+    atom_setsym(temp_list, x->analysis_output);
+    outlet_list(x->out, gensym("analysis_output"), 2, (t_atom*)state);
+    
+    //incremental
+    temp_list = (t_atom*)state;
+    atom_setsym(temp_list, gensym("incremental"));
+    temp_list++;
+    atom_setlong(temp_list, x->incremental);
+    outlet_list(x->out, gensym("incremental"), 2, (t_atom*)state);
+    
     //vector length
     temp_list = (t_atom*)state;
     atom_setsym(temp_list, gensym("vector_size"));
     temp_list++;
-    atom_setlong(temp_list, x->series_vector_size);
+    atom_setlong(temp_list, x->core.series_vector_size);
     outlet_list(x->out, gensym("vector_size"), 2, (t_atom*)state);
     
+    //channels
+    temp_list = (t_atom*)state;
+    atom_setsym(temp_list, gensym("channels"));
+    temp_list++;
+    atom_setlong(temp_list, x->channels);
+    outlet_list(x->out, gensym("channels"), 2, (t_atom*)state);
+    
     temp_list = NULL;
-    sysmem_freeptr(state);
     
+    sc_util_apen_stats(x, gensym("stats"), 0, NULL);
     sc_util_apen_dump(x);
     
 }
 
-void sc_util_apen_int(t_sc_util_apen *x, long n)
-{
-    
-    critical_enter(0);
-    
-    if(x->series_length < x->series_max_length) {
-        double* temp = x->test_value + x->series_length;
-        *temp = (double) n;
-        x->series_length++;
-    } else {
-        double* temp = x->test_value;
-        double* temp2 = temp;
-        temp2++;
-        
-        sysmem_copyptr(temp2, temp, sizeof(double) * (x->series_max_length - 1));
-        temp = x->test_value + (x->series_max_length - 1);
-        *temp = (double)n;
+//allocates the memory list and dump work in, for a series of max_length vectors of dims values
+/* One block: max_length * dims doubles for list_values followed by two lists of max_length * dims + 2 atoms for dump_atoms
+ (the values, their selector and, with more than one channel, the channel number).
+ It is made outside of the lock and only swapped in by sc_util_apen_scratch_set once the core has been resized.
+ */
+void* sc_util_apen_scratch_new(long max_length, long dims) {
+    return sysmem_newptr(sizeof(double) * max_length * dims + 2 * sizeof(t_atom) * (max_length * dims + 2));
+}
+
+//called with lock held, NULL frees both the current and the retired block
+/* The block replaced is kept until the next one replaces it: an object below the dumpout that changes series_length
+ while a dump goes out must not free the list it is reading.
+ */
+void sc_util_apen_scratch_set(t_sc_util_apen *x, void* scratch, long max_length, long dims) {
+    if(x->scratch_retired) {
+        sysmem_freeptr(x->scratch_retired);
+    }
+    x->scratch_retired = x->scratch;
+    if(!scratch && x->scratch_retired) {
+        sysmem_freeptr(x->scratch_retired);
+        x->scratch_retired = NULL;
+    }
+    x->scratch = scratch;
+    x->list_values = scratch ? (double*)scratch : NULL;
+    x->dump_atoms = scratch ? (t_atom*)(x->list_values + max_length * dims) : NULL;
+    x->scratch_values = scratch ? max_length * dims : 0;
+}
 
+//outputs the performance counters through the dumpout, one name and value per list like getstate
+/* calc_time is the last calculation and calc_time_avg the mean over every calculation, both in ms,
+ including calculations done by the worker thread. comparisons counts the pairs of windows compared for the
+ match counts, by calculations and by incremental updates, and early_exit_rate the share of them
+ that failed at pattern_length and so needed no further elements. cached counts the calculations (of every channel)
+ answered with the previous result because nothing had changed since.
+ */
+void sc_util_apen_stats(t_sc_util_apen *x, t_symbol *s, long argc, t_atom *argv) {
+    if(argc && atom_gettype(argv) == A_SYM && atom_getsym(argv) == gensym("reset")) {
+        critical_enter(x->lock);
+        x->stat_last_time = 0.0;
+        x->stat_total_time = 0.0;
+        x->stat_calculations = 0;
+        x->stat_inputs = 0;
+        x->stat_skipped = 0;
+        x->stat_coalesced = 0;
+        for(long c = 0; c < x->channels; c++) {
+            sc_util_apen_channel(x, c)->stats.comparisons = 0;
+            sc_util_apen_channel(x, c)->stats.rejections = 0;
+            sc_util_apen_channel(x, c)->stats.cached = 0;
+        }
+        critical_exit(x->lock);
+        return;
     }
     
-    critical_exit(0);
+    const char* names[] = {"calc_time", "calc_time_avg", "calculations", "comparisons", "early_exit_rate", "inputs", "skipped", "coalesced", "cached"};
+    long counts[] = {0, 0, 1, 1, 0, 1, 1, 1, 1}; //output as ints while they fit
+    double values[9];
+    double comparisons = 0.0;
+    double rejections = 0.0;
+    double cached = 0.0;
     
-    if(x->calc_on_input == 1) {
-        sc_util_apen_calculate(x);
+    critical_enter(x->lock);
+    //every channel counts its own comparisons, a batch of channels is one calculation
+    for(long c = 0; c < x->channels; c++) {
+        comparisons += sc_util_apen_channel(x, c)->stats.comparisons;
+        rejections += sc_util_apen_channel(x, c)->stats.rejections;
+        cached += sc_util_apen_channel(x, c)->stats.cached;
+    }
+    values[0] = x->stat_last_time;
+    values[1] = x->stat_calculations ? x->stat_total_time / x->stat_calculations : 0.0;
+    values[2] = x->stat_calculations;
+    values[3] = comparisons;
+    values[4] = (comparisons > 0) ? rejections / comparisons : 0.0;
+    values[5] = x->stat_inputs;
+    values[6] = x->stat_skipped;
+    values[7] = x->stat_coalesced;
+    values[8] = cached;
+    critical_exit(x->lock);
+    
+    t_atom state[2];
+    for(int i = 0; i < 9; i++) {
+        atom_setsym(state, gensym(names[i]));
+        if(counts[i] && values[i] <= 2147483647.0) {
+            atom_setlong(state + 1, (long)values[i]);
+        } else {
+            atom_setfloat(state + 1, values[i]);
+        }
+        outlet_list(x->out, gensym(names[i]), 2, state);
     }
 }
 
+void sc_util_apen_int(t_sc_util_apen *x, long n)
+{
+    sc_util_apen_float(x, (double)n);
+}
+
 void sc_util_apen_float(t_sc_util_apen *x, double f)
 {
-    critical_enter(0);
+    critical_enter(x->lock);
     
-    if(x->series_length < x->series_max_length) {
-        double* temp = x->test_value + x->series_length;
-        
-        *temp = f;
-        x->series_length++;
-    } else {
-        double* temp = x->test_value;
-        double* temp2 = temp;
-        temp2++;
-        
-        sysmem_copyptr(temp2, temp, sizeof(double) * (x->series_max_length - 1));
-        temp = x->test_value + (x->series_max_length - 1);
-        *temp = f;
+    //channels and vector_size change from other threads, check them with the append
+    long channels = x->channels;
+    long vs = x->core.series_vector_size;
+    if(channels == 1 && vs == 1) {
+        sc_util_apen_core_append(&x->core, &f);
+        x->stat_inputs++;
     }
     
-    critical_exit(0);
+    critical_exit(x->lock);
     
-    if(x->calc_on_input == 1) {
-        sc_util_apen_calculate(x);
+    if(channels > 1) {
+        object_warn((t_object*)x, "Expecting a channel number followed by values");
+        return;
+    }
+    if(vs > 1) {
+        object_warn((t_object*)x, "Expecting a list of %ld values", vs);
+        return;
     }
+    
+    sc_util_apen_input_done(x, 1);
 }
 
+//adds a list of consecutive vectors to the series
+/* The values are converted into list_values, which is sized with the series,
+ so a list never allocates no matter how long it is. Only the most recent series_length vectors are kept.
+ With more than one channel the list starts with the channel (1 ... channels) the vectors are added to.
+ */
 void sc_util_apen_list(t_sc_util_apen *x, t_symbol* a, long argc, t_atom *argv) {
     
-
+    critical_enter(x->lock);
+    
+    t_sc_util_apen_core* core = &x->core;
+    if(x->channels > 1) {
+        long channel = 0;
+        switch(argc ? atom_gettype(argv) : A_NOTHING) {
+            case A_LONG:
+                channel = atom_getlong(argv);
+                break;
+            case A_FLOAT:
+                channel = (long)atom_getfloat(argv);
+                break;
+            default:
+                break;
+        }
+        if(channel < 1 || channel > x->channels) {
+            critical_exit(x->lock);
+            object_warn((t_object*)x, "List must start with a channel from 1 to %ld", x->channels);
+            return;
+        }
+        core = sc_util_apen_channel(x, channel - 1);
+        argc--;
+        argv++;
+    }
+    
+    long vs = core->series_vector_size;
+    
+    //the list is read as consecutive vectors of vector_size values
+    if(argc % vs != 0) {
+        critical_exit(x->lock);
+        object_warn((t_object*)x, "List length must be a multiple of vector_size (%ld)", vs);
+        return;
+    }
+    
     t_atom* arg_temp = argv;
-    long data_list_size = argc;
+    long data_list_size = argc / vs; //number of vectors
     long arg_offset = 0;
-    if(argc > x->series_max_length)
+    long room = x->scratch_values / vs; //only smaller than series_length for a channel that could not be resized with channel 1
+    long keep = (core->series_max_length < room) ? core->series_max_length : room;
+    if(data_list_size > keep)
     {
-        data_list_size = x->series_max_length;
-        arg_offset = argc - x->series_max_length;
+        data_list_size = keep;
+        arg_offset = argc - keep * vs;
     }
     
-    double data_list[data_list_size];
+    double* data_list = x->list_values;
     arg_temp += arg_offset;
     
-    for(int i = 0; i < data_list_size && (i + arg_offset) < argc; i++, arg_temp++) {
+    for(int i = 0; i < data_list_size * vs && (i + arg_offset) < argc; i++, arg_temp++) {
         switch(atom_gettype(arg_temp)) {
             case A_LONG:
                 data_list[i] = (double)atom_getlong(arg_temp);
@@ -311,67 +718,121 @@ void sc_util_apen_list(t_sc_util_apen *x, t_symbol* a, long argc, t_atom *argv)
                 data_list[i] = atom_getfloat(arg_temp);
                 break;
             default:
+                critical_exit(x->lock);
                 object_warn((t_object*)x, "Received non-numeric input");
                 return;
         }
     }
     
-    critical_tryenter(0);
-    /*
-    arg_temp = argv;
-    int idx = 0;
-    long data_size = argc;
-    if(argc > x->series_max_length) {
-        arg_temp += argc - x->series_max_length;
-        idx = argc - x->series_max_length;
-        data_size = x->series_max_length;
-    }
-    //double data_list;// = (double*)sysmem_newptr(sizeof(double) * data_size);
-     
-     for(; idx < argc; idx++, arg_temp++, data_temp++) {
-        switch(atom_gettype(arg_temp)) {
-            case A_LONG:
-                *data_temp = (double)atom_getlong(arg_temp);
-                break;
-            case A_FLOAT:
-                *data_temp = atom_getfloat(arg_temp);
-                break;
-        }
-     }
-    */
+    sc_util_apen_core_append_list(core, data_list, data_list_size);
+    x->stat_inputs++;
     
-    //double* data_temp = data_list;
+    critical_exit(x->lock);
+    
+    sc_util_apen_input_done(x, data_list_size);
+}
 
+//frame <values>, adds one vector to every channel
+/* The values are vector_size values for channel 1, then for channel 2 and so on,
+ so a whole set of sensors is added with one message instead of one per channel.
+ */
+void sc_util_apen_frame(t_sc_util_apen *x, t_symbol *s, long argc, t_atom *argv) {
     
-    long tot_size = x->series_length + data_list_size;
+    critical_enter(x->lock);
     
-    long del_idx = 0;
+    long needed = 0;
+    for(long c = 0; c < x->channels; c++) {
+        needed += sc_util_apen_channel(x, c)->series_vector_size;
+    }
+    if(argc != needed) {
+        critical_exit(x->lock);
+        object_warn((t_object*)x, "frame needs vector_size values for each of the %ld channels, %ld in all", x->channels, needed);
+        return;
+    }
+    //checked first so a bad frame adds nothing to any channel
+    for(long i = 0; i < argc; i++) {
+        if(atom_gettype(argv + i) != A_LONG && atom_gettype(argv + i) != A_FLOAT) {
+            critical_exit(x->lock);
+            object_warn((t_object*)x, "Received non-numeric input");
+            return;
+        }
+    }
     
-    if(tot_size > x->series_max_length) {
-        del_idx = tot_size - x->series_max_length;
-        double* temp0 = x->test_value + del_idx;
-        double* temp1 = x->test_value;
-        sysmem_copyptr(temp0, temp1, sizeof(double) * (x->series_max_length - del_idx));
-        x->series_length = (x->series_length - del_idx > 0) ? (x->series_length - del_idx) : 0;
+    t_atom* arg_temp = argv;
+    for(long c = 0; c < x->channels; c++) {
+        t_sc_util_apen_core* core = sc_util_apen_channel(x, c);
+        long vs = core->series_vector_size;
+        if(vs > x->scratch_values) {
+            //a channel that could not be resized with channel 1
+            arg_temp += vs;
+            continue;
+        }
+        for(int k = 0; k < vs; k++, arg_temp++) {
+            x->list_values[k] = atom_getfloat(arg_temp);
+        }
+        sc_util_apen_core_append(core, x->list_values);
     }
+    x->stat_inputs++;
+    
+    critical_exit(x->lock);
     
-    double* temp = x->test_value + x->series_length;
+    sc_util_apen_input_done(x, x->channels);
+}
+
+//calculates after new input when calculate_on_input is set
+/* Values are always stored as soon as they arrive, only the calculation is held back.
+ A calculation needs at least hop_size new values since the last one, and at least calc_interval ms
+ since the last one. Input arriving too early sets calc_clock for the end of the interval,
+ and everything arriving before the clock fires is covered by that one calculation.
+ With more than one channel the values of every channel count towards hop_size, and the calculation always
+ waits for calc_clock, at least until the end of the current scheduler tick, so channels receiving input
+ in the same tick are calculated as one batch and output as one list.
+ */
+void sc_util_apen_input_done(t_sc_util_apen *x, long added) {
+    if(x->calc_on_input != 1) {
+        return;
+    }
     
-    sysmem_copyptr(&data_list, temp, sizeof(double) * data_list_size);
-    /*
-    //free data
-    data_temp = data_list;
-    for(int i = 0; i < data_size; i++) {
-        double* d2 = data_temp;
-        data_temp++;
-        sysmem_freeptr(d2);
+    //input arrives from the main and scheduler threads, only one of them may set calc_scheduled
+    critical_enter(x->lock);
+    x->samples_since_calc += added;
+    long ready = (x->samples_since_calc >= x->hop_size);
+    long calculate = 0;
+    double wait = -1.0; //time to set calc_clock for, negative for no clock
+    if(!ready) {
+        x->stat_skipped++;
+    } else if(x->calc_scheduled) {
+        x->stat_coalesced++;
+    } else if(x->calc_interval > 0.0 || x->channels > 1) {
+        double now = 0.0;
+        clock_getftime(&now);
+        double left = x->last_calc_time + x->calc_interval - now;
+        if(left > 0.0 || x->channels > 1) {
+            x->calc_scheduled = 1;
+            wait = (left > 0.0) ? left : 0.0;
+        } else {
+            calculate = 1;
+        }
+    } else {
+        calculate = 1;
     }
-    */
-    x->series_length += data_list_size;
+    critical_exit(x->lock);
     
-    critical_exit(0);
+    if(wait >= 0.0) {
+        clock_fdelay(x->calc_clock, wait);
+    } else if(calculate) {
+        sc_util_apen_calculate(x);
+    }
+}
+
+void sc_util_apen_tick(t_sc_util_apen *x) {
+    critical_enter(x->lock);
+    x->calc_scheduled = 0;
+    //a bang may have calculated while the clock was waiting
+    long ready = (x->samples_since_calc >= x->hop_size);
+    critical_exit(x->lock);
     
-    if(x->calc_on_input == 1) {
+    if(ready) {
         sc_util_apen_calculate(x);
     }
 }
@@ -388,113 +849,573 @@ void sc_util_apen_bang(t_sc_util_apen *x)
 }
 
 
+//outputs the series out the dumpout as values v0 v1 ...
+/* With more than one channel there is one list per channel, values <channel> v0 v1 ...
+ Each list is made under the lock in the next list of dump_atoms and output after leaving it,
+ objects below the dumpout may send straight back into this one.
+ */
 void sc_util_apen_dump(t_sc_util_apen *x) {
- 
-    critical_tryenter(0);
-
-    if(x->series_length > 0){
-        double* d = x->test_value;
+    
+    for(long c = 0; ; c++) {
+        critical_enter(x->lock);
+        if(c >= x->channels) {
+            critical_exit(x->lock);
+            break;
+        }
+        t_sc_util_apen_core* core = sc_util_apen_channel(x, c);
+        if(core->series_length <= 0 || !x->dump_atoms) {
+            critical_exit(x->lock);
+            continue;
+        }
+        long vs = core->series_vector_size;
+        long length = core->series_length;
+        if(length * vs > x->scratch_values) {
+            //a channel that could not be resized with channel 1, only its most recent values fit
+            length = x->scratch_values / vs;
+        }
+        double* d = core->test_value + core->series_head + core->series_length - length; //the series is contiguous from the oldest value
+        long count = length * vs;
         
-        void* mem = sysmem_newptr(sizeof(t_atom) * (x->series_length + 1));
-        t_atom* list = (t_atom*)mem;
+        t_atom* list = x->dump_atoms + x->dump_turn * (x->scratch_values + 2); //room for the longest series, so dump never allocates
+        x->dump_turn = !x->dump_turn;
         t_atom* temp_list = list;
         atom_setsym(temp_list, gensym("values"));
         temp_list++;
-        for(int i = 0; i < x->series_length; i++, d++, temp_list++) {
-            atom_setfloat(temp_list, *d);
+        if(x->channels > 1) {
+            atom_setlong(temp_list, c + 1);
+            temp_list++;
+            count++;
         }
-        outlet_list((void*)x->out, gensym("values"), x->series_length, list);
-        
-        sysmem_freeptr(mem);
+        //vectors are output whole, one after the other
+        for(int i = 0; i < length; i++, d++) {
+            for(int k = 0; k < vs; k++, temp_list++) {
+                atom_setfloat(temp_list, d[k * 2 * core->series_max_length]);
+            }
+        }
+        critical_exit(x->lock);
         
+        outlet_list((void*)x->out, gensym("values"), count + 1, list);
     }
-    critical_exit(0);
     
 }
 
-//empties list of data
-void sc_util_apen_clear(t_sc_util_apen *x){
+//analyze <buffer~> [window] [hop]
+/* Channel k of the buffer~ is dimension k of the series, so the buffer~ needs at least vector_size channels.
+ The samples are converted to doubles once, straight from the buffer~ memory, and never go through atoms.
+ */
+void sc_util_apen_analyze(t_sc_util_apen *x, t_symbol *s, long argc, t_atom *argv) {
+    if(!argc || atom_gettype(argv) != A_SYM) {
+        object_error((t_object *)x, "analyze needs the name of a buffer~");
+        return;
+    }
+    
+    t_buffer_ref* ref = buffer_ref_new((t_object *)x, atom_getsym(argv));
+    t_buffer_obj* buffer = buffer_ref_getobject(ref);
+    if(!buffer) {
+        object_error((t_object *)x, "no buffer~ named %s", atom_getsym(argv)->s_name);
+        object_free(ref);
+        return;
+    }
+    
+    long dims = x->core.series_vector_size;
+    long channels = buffer_getchannelcount(buffer);
+    long frames = buffer_getframecount(buffer);
+    long window = 0;
+    long hop = 0;
+    if(channels < dims) {
+        object_error((t_object *)x, "buffer~ %s has %ld channels, vector_size needs %ld", atom_getsym(argv)->s_name, channels, dims);
+        object_free(ref);
+        return;
+    }
+    if(!sc_util_apen_analysis_args(x, argc - 1, argv + 1, frames, &window, &hop)) {
+        object_free(ref);
+        return;
+    }
+    
+    double* series = (double*)sysmem_newptr(sizeof(double) * frames * dims);
+    if(!series) {
+        object_error((t_object *)x, "not enough memory to analyze %ld frames", frames);
+        object_free(ref);
+        return;
+    }
+    float* samples = buffer_locksamples(buffer);
+    if(!samples) {
+        sysmem_freeptr(series);
+        object_free(ref);
+        return;
+    }
+    for(long t = 0; t < frames; t++) {
+        for(int k = 0; k < dims; k++) {
+            series[k * frames + t] = samples[t * channels + k];
+        }
+    }
+    buffer_unlocksamples(buffer);
+    object_free(ref);
     
-    critical_enter(0);
+    sc_util_apen_analysis_run(x, series, frames, dims, frames, window, hop);
+    sysmem_freeptr(series);
+}
 
-    double* temp = x->test_value;
+//read <file> [window] [hop]
+/* The file holds raw 64-bit floats in the machine's byte order, vectors one after the other as dump outputs them.
+ It is memory mapped rather than read in, and with a vector_size of 1 the windows are calculated straight
+ from the mapped file. Larger vectors are split into one plane per dimension first.
+ */
+void sc_util_apen_read(t_sc_util_apen *x, t_symbol *s, long argc, t_atom *argv) {
+    char filename[MAX_FILENAME_CHARS];
+    char fullpath[MAX_PATH_CHARS];
+    short path = 0;
+    t_fourcc type = 0;
+    
+    if(!argc || atom_gettype(argv) != A_SYM) {
+        object_error((t_object *)x, "read needs a file name");
+        return;
+    }
+    strncpy(filename, atom_getsym(argv)->s_name, MAX_FILENAME_CHARS - 1);
+    filename[MAX_FILENAME_CHARS - 1] = 0;
+    if(locatefile_extended(filename, &path, &type, NULL, 0) || path_toabsolutesystempath(path, filename, fullpath)) {
+        object_error((t_object *)x, "can't find %s", atom_getsym(argv)->s_name);
+        return;
+    }
     
-    for(int i = 0; i < x->series_length; i++, temp++) {
-        *temp = 0;
+    //map the whole file read only
+    double* mapped = NULL;
+    long size = 0;
+#ifdef WIN_VERSION
+    HANDLE file = CreateFileA(fullpath, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    HANDLE mapping = NULL;
+    LARGE_INTEGER file_size;
+    if(file != INVALID_HANDLE_VALUE && GetFileSizeEx(file, &file_size) && file_size.QuadPart > 0) {
+        size = (long)file_size.QuadPart;
+        mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+        if(mapping) {
+            mapped = (double*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        }
     }
+#else
+    int file = open(fullpath, O_RDONLY);
+    struct stat file_stat;
+    if(file >= 0 && !fstat(file, &file_stat) && file_stat.st_size > 0) {
+        size = (long)file_stat.st_size;
+        mapped = (double*)mmap(NULL, size, PROT_READ, MAP_PRIVATE, file, 0);
+        if(mapped == (double*)MAP_FAILED) {
+            mapped = NULL;
+        }
+    }
+#endif
     
-    x->series_length = 0;
+    long dims = x->core.series_vector_size;
+    long length = size / (sizeof(double) * dims);
+    long window = 0;
+    long hop = 0;
+    if(!mapped) {
+        object_error((t_object *)x, "can't map %s", fullpath);
+    } else if(sc_util_apen_analysis_args(x, argc - 1, argv + 1, length, &window, &hop)) {
+        if(dims == 1) {
+            sc_util_apen_analysis_run(x, mapped, length, 1, length, window, hop);
+        } else {
+            double* series = (double*)sysmem_newptr(sizeof(double) * length * dims);
+            if(series) {
+                for(long t = 0; t < length; t++) {
+                    for(int k = 0; k < dims; k++) {
+                        series[k * length + t] = mapped[t * dims + k];
+                    }
+                }
+                sc_util_apen_analysis_run(x, series, length, dims, length, window, hop);
+                sysmem_freeptr(series);
+            } else {
+                object_error((t_object *)x, "not enough memory to analyze %ld values", length * dims);
+            }
+        }
+    }
     
-    critical_exit(0);
+#ifdef WIN_VERSION
+    if(mapped) {
+        UnmapViewOfFile(mapped);
+    }
+    if(mapping) {
+        CloseHandle(mapping);
+    }
+    if(file != INVALID_HANDLE_VALUE) {
+        CloseHandle(file);
+    }
+#else
+    if(mapped) {
+        munmap(mapped, size);
+    }
+    if(file >= 0) {
+        close(file);
+    }
+#endif
+}
+
+//reads the optional window and hop arguments, window defaults to series_length and hop to window
+long sc_util_apen_analysis_args(t_sc_util_apen *x, long argc, t_atom *argv, long length, long* window, long* hop) {
+    *window = (argc > 0) ? atom_getlong(argv) : x->core.series_max_length;
+    *hop = (argc > 1) ? atom_getlong(argv + 1) : *window;
     
+    if(*window < x->core.pattern_length * 2) {
+        object_error((t_object *)x, "analysis window must be >= %ld", x->core.pattern_length * 2);
+        return 0;
+    }
+    if(*hop < 1) {
+        object_error((t_object *)x, "analysis hop must be >= 1");
+        return 0;
+    }
+    if(length < *window) {
+        object_error((t_object *)x, "%ld values are not enough for a window of %ld", length, *window);
+        return 0;
+    }
+    return 1;
 }
 
-//sets the maximum length of the series
-void sc_util_apen_set_series_length(t_sc_util_apen *x, void *attr, long argc, t_atom *argv){
-    if(argc && argv) {
-        
-        long temp_sl = 0;
-        
-        switch(atom_gettype(argv)){
-            case A_LONG:
-                temp_sl = atom_getlong(argv);
-                break;
-            case A_FLOAT:
-                temp_sl = (long)atom_getfloat(argv);
-                break;
-            default:
-                object_error((t_object *)x, "bad value for series_length");
-                return;
-                break;
+//calculates every window and writes the results
+/* The windows start every hop values and are calculated with the same code as the object's own series,
+ with mode choosing the values kept for each window. The results go into the buffer~ named by analysis_output,
+ resized to one frame per window with one channel per value, or into a dictionary with one array per estimator
+ whose name comes out the right outlet.
+ */
+void sc_util_apen_analysis_run(t_sc_util_apen *x, double* series, long length, long dims, long stride, long window, long hop) {
+    long count = (length - window) / hop + 1; //number of windows
+    long m = x->core.pattern_length;
+    double r = x->core.similarity_factor;
+    long relative = (x->core.similarity_mode == SC_UTIL_APEN_SIMILARITY_RELATIVE);
+    long mode = x->mode;
+    t_sc_util_apen_sampling sampling = {x->core.estimate_samples, x->core.estimate_seed, NULL}; //long windows are sampled like the object's own series
+    
+    //indices into the values of sc_util_apen_estimate that mode keeps
+    long keep[3] = {0, 1, 2};
+    long per = 1;
+    switch(mode) {
+        case SC_UTIL_APEN_MODE_SAMPEN:
+            keep[0] = 1;
+            break;
+        case SC_UTIL_APEN_MODE_FUZZYEN:
+            keep[0] = 2;
+            break;
+        case SC_UTIL_APEN_MODE_COMBINED:
+            per = 2;
+            break;
+        case SC_UTIL_APEN_MODE_ALL:
+            per = 3;
+            break;
+        default:
+            break;
+    }
+    
+    double* values = (double*)sysmem_newptr(sizeof(double) * count * per);
+    long* c0 = (long*)sysmem_newptr(sizeof(long) * window);
+    long* c1 = (long*)sysmem_newptr(sizeof(long) * window);
+    void* work = sysmem_newptr(sc_util_apen_work_size(window, dims)); //shared by every window
+    if(!values || !c0 || !c1 || !work) {
+        object_error((t_object *)x, "not enough memory to analyze %ld windows", count);
+        if(values) {
+            sysmem_freeptr(values);
         }
-
-        
-        if(temp_sl > ((2 * x->pattern_length) + 1) && temp_sl != x->series_max_length) {
-            critical_enter(0);
-            
-            double* temp = (double*)sysmem_newptr(sizeof(double) * temp_sl);
-            long byte_length = 0;
+        if(c0) {
+            sysmem_freeptr(c0);
+        }
+        if(c1) {
+            sysmem_freeptr(c1);
+        }
+        if(work) {
+            sysmem_freeptr(work);
+        }
+        return;
+    }
+    
+    for(long w = 0; w < count; w++) {
+        double res[3];
+        //in relative mode every window is measured against its own standard deviation
+        double wr = relative ? r * sc_util_apen_sd(series + w * hop, window, dims, stride) : r;
+        sc_util_apen_estimate(series + w * hop, window, dims, stride, m, wr, mode, c0, c1, 0, res, work, NULL, &sampling);
+        for(int v = 0; v < per; v++) {
+            values[w * per + v] = res[keep[v]];
+        }
+    }
+    sysmem_freeptr(c0);
+    sysmem_freeptr(c1);
+    sysmem_freeptr(work);
+    
+    t_atom result[2];
+    if(x->analysis_output != gensym("")) {
+        t_buffer_ref* ref = buffer_ref_new((t_object *)x, x->analysis_output);
+        t_buffer_obj* buffer = buffer_ref_getobject(ref);
+        if(buffer) {
+            //sizeinsamps takes the channel count after the frame count
+            atom_setlong(result, count);
+            atom_setlong(result + 1, per);
+            typedmess((t_object *)buffer, gensym("sizeinsamps"), 2, result);
             
-            if(temp_sl > x->series_max_length) {
-                byte_length = sizeof(double) * x->series_max_length;
-            } else {
-                byte_length = sizeof(double) * temp_sl;
+            long channels = buffer_getchannelcount(buffer);
+            if(channels < per) {
+                object_error((t_object *)x, "buffer~ %s has %ld channels for %ld values per window, only the first %ld are written", x->analysis_output->s_name, channels, per, channels);
             }
-            sysmem_copyptr(x->test_value, temp, byte_length);
-            
-            
-            //clear old data
-            
-            double old_max = x->series_max_length;
-            double* d_temp = x->test_value;
-            
-            x->test_value = temp;
-            
-            for(int i = 0; i < old_max; i++){
-                double* dt2 = d_temp;
-                d_temp++;
-                sysmem_freeptr(dt2);
+            float* samples = buffer_locksamples(buffer);
+            if(samples) {
+                long frames = buffer_getframecount(buffer);
+                long used = (channels < per) ? channels : per;
+                for(long w = 0; w < count && w < frames; w++) {
+                    for(int v = 0; v < used; v++) {
+                        samples[w * channels + v] = values[w * per + v];
+                    }
+                }
+                buffer_setdirty(buffer);
+                buffer_unlocksamples(buffer);
             }
             
-            
-            if(x->series_length > temp_sl) {
-                x->series_length = temp_sl;
+            atom_setsym(result, x->analysis_output);
+            atom_setlong(result + 1, count);
+            outlet_anything(x->out, gensym("analysis"), 2, result);
+        } else {
+            object_error((t_object *)x, "no buffer~ named %s for analysis_output", x->analysis_output->s_name);
+        }
+        object_free(ref);
+    } else {
+        const char* names[3] = {"apen", "sampen", "fuzzyen"};
+        t_dictionary* dict = dictionary_new();
+        t_atom* list = (t_atom*)sysmem_newptr(sizeof(t_atom) * count);
+        
+        dictionary_appendlong(dict, gensym("window"), window);
+        dictionary_appendlong(dict, gensym("hop"), hop);
+        for(int v = 0; list && v < per; v++) {
+            for(long w = 0; w < count; w++) {
+                atom_setfloat(list + w, values[w * per + v]);
             }
-            
-            x->series_max_length = temp_sl;
-            critical_exit(0);
-        } else if(temp_sl != x->series_max_length){
-            object_error((t_object *)x, "Series length too short, must >= %d", (2 * x->pattern_length) + 1);
+            dictionary_appendatoms(dict, gensym(names[keep[v]]), count, list);
+        }
+        if(list) {
+            sysmem_freeptr(list);
+        }
+        
+        //the previous results are released when new ones replace them
+        if(x->analysis_dict) {
+            object_free(x->analysis_dict);
         }
+        t_symbol* name = NULL;
+        x->analysis_dict = dictobj_register(dict, &name);
+        
+        atom_setsym(result, name);
+        outlet_anything(x->out, gensym("dictionary"), 1, result);
     }
+    
+    sysmem_freeptr(values);
 }
 
-void sc_util_apen_get_series_length(t_sc_util_apen *x, t_object *attr, long *argc, t_atom **argv){
-    char alloc;
-    long sl = 0;
+//sweep r <values> m <values>
+/* Calculates ApEn of the current series for every pair of similarity and pattern_length values. Numbers before
+ either keyword are similarity values, and a missing list uses the attribute's current value. Each pattern_length
+ costs a single pass over the pairs of windows however many similarity values there are, see sc_util_apen_count_sweep.
+ One row "sweep m apen..." per pattern_length comes out the right outlet, with the values in the order r was given.
+ */
+void sc_util_apen_sweep(t_sc_util_apen *x, t_symbol *s, long argc, t_atom *argv) {
+    t_sc_util_apen_key r[SC_UTIL_APEN_MAX_SWEEP]; //similarity values sorted ascending, index is their place in the message
+    double r_sorted[SC_UTIL_APEN_MAX_SWEEP];
+    long m[SC_UTIL_APEN_MAX_SWEEP];
+    long nr = 0;
+    long nm = 0;
+    long list = 0; //0 while reading similarity values, 1 for pattern_length values
     
-    atom_alloc(argc, argv, &alloc);
-    sl = x->series_max_length;
+    for(int i = 0; i < argc; i++) {
+        if(atom_gettype(argv + i) == A_SYM) {
+            if(atom_getsym(argv + i) == gensym("r")) {
+                list = 0;
+            } else if(atom_getsym(argv + i) == gensym("m")) {
+                list = 1;
+            } else {
+                object_error((t_object *)x, "sweep expects r <values> m <values>");
+                return;
+            }
+        } else if(list == 0 && nr < SC_UTIL_APEN_MAX_SWEEP) {
+            r[nr].value = atom_getfloat(argv + i);
+            r[nr].index = nr;
+            if(r[nr].value <= 0.0) {
+                object_error((t_object *)x, "Similarity must be > 0.0, received %f", r[nr].value);
+                return;
+            }
+            nr++;
+        } else if(list == 1 && nm < SC_UTIL_APEN_MAX_SWEEP) {
+            m[nm] = atom_getlong(argv + i);
+            if(m[nm] <= 1 || m[nm] > (x->core.series_max_length / 2) - 1) {
+                object_error((t_object *)x, "pattern_length must be an integer > 1 and <= %ld", (x->core.series_max_length / 2) - 1);
+                return;
+            }
+            nm++;
+        } else {
+            object_error((t_object *)x, "sweep takes at most %d values of each", SC_UTIL_APEN_MAX_SWEEP);
+            return;
+        }
+    }
+    if(!nr) {
+        r[0].value = x->core.similarity_factor;
+        r[0].index = 0;
+        nr = 1;
+    }
+    if(!nm) {
+        m[0] = x->core.pattern_length;
+        nm = 1;
+    }
+    qsort(r, nr, sizeof(t_sc_util_apen_key), sc_util_apen_key_compare);
+    for(int k = 0; k < nr; k++) {
+        r_sorted[k] = r[k].value;
+    }
+    
+    //the sweep works on a copy of the series, input only waits for the copy
+    critical_enter(x->lock);
+    long length = x->core.series_length;
+    long dims = x->core.series_vector_size;
+    double* series = (double*)sysmem_newptr(sizeof(double) * (length ? length : 1) * dims);
+    if(series) {
+        sc_util_apen_core_copy(&x->core, series);
+    }
+    critical_exit(x->lock);
+    
+    //in relative mode the values are multiples of the standard deviation of the series
+    if(series && x->core.similarity_mode == SC_UTIL_APEN_SIMILARITY_RELATIVE) {
+        double sd = sc_util_apen_sd(series, length, dims, length);
+        for(int k = 0; k < nr; k++) {
+            r_sorted[k] *= sd;
+        }
+    }
+    
+    double* apen = (double*)sysmem_newptrclear(sizeof(double) * nm * nr);
+    long* c0 = (long*)sysmem_newptr(sizeof(long) * nr * (length + 1));
+    long* c1 = (long*)sysmem_newptr(sizeof(long) * nr * (length + 1));
+    if(!series || !apen || !c0 || !c1) {
+        object_error((t_object *)x, "not enough memory to sweep %ld values", nm * nr);
+        if(series) {
+            sysmem_freeptr(series);
+        }
+        if(apen) {
+            sysmem_freeptr(apen);
+        }
+        if(c0) {
+            sysmem_freeptr(c0);
+        }
+        if(c1) {
+            sysmem_freeptr(c1);
+        }
+        return;
+    }
+    
+    for(int p = 0; p < nm; p++) {
+        //rows without enough data are left at 0
+        if(length < m[p] * 2) {
+            if(x->hold_size_warning == 1) {
+                object_warn((t_object*)x, "Not enough data to sweep pattern_length %ld, need %ld data points, have %ld", m[p], m[p] * 2, length);
+            }
+            continue;
+        }
+        
+        long n0 = length - m[p] + 1;
+        sc_util_apen_count_sweep(series, length, dims, length, m[p], r_sorted, nr, c0, c1);
+        for(int k = 0; k < nr; k++) {
+            apen[p * nr + r[k].index] = sc_util_apen_from_counts(length, m[p], c0 + k * n0, c1 + k * n0);
+        }
+    }
+    
+    sysmem_freeptr(series);
+    sysmem_freeptr(c0);
+    sysmem_freeptr(c1);
+    
+    t_atom row[SC_UTIL_APEN_MAX_SWEEP + 1];
+    for(int p = 0; p < nm; p++) {
+        atom_setlong(row, m[p]);
+        for(int k = 0; k < nr; k++) {
+            atom_setfloat(row + k + 1, apen[p * nr + k]);
+        }
+        outlet_anything(x->out, gensym("sweep"), nr + 1, row);
+    }
+    sysmem_freeptr(apen);
+}
+
+//sets the buffer~ analyze and read write into
+void sc_util_apen_set_analysis_output(t_sc_util_apen *x, void *attr, long argc, t_atom *argv){
+    if(argc && argv) {
+        if(atom_gettype(argv) == A_SYM) {
+            x->analysis_output = atom_getsym(argv);
+        } else {
+            object_error((t_object *)x, "analysis_output must be the name of a buffer~");
+        }
+    } else {
+        x->analysis_output = gensym("");
+    }
+}
+
+void sc_util_apen_get_analysis_output(t_sc_util_apen *x, t_object *attr, long *argc, t_atom **argv){
+    char alloc;
+    
+    atom_alloc(argc, argv, &alloc);
+    atom_setsym(*argv, x->analysis_output);
+}
+
+//empties list of data
+void sc_util_apen_clear(t_sc_util_apen *x){
+    
+    critical_enter(x->lock);
+    for(long c = 0; c < x->channels; c++) {
+        sc_util_apen_core_clear(sc_util_apen_channel(x, c));
+    }
+    critical_exit(x->lock);
+    
+}
+
+//sets the maximum length of the series
+void sc_util_apen_set_series_length(t_sc_util_apen *x, void *attr, long argc, t_atom *argv){
+    if(argc && argv) {
+        
+        long temp_sl = 0;
+        
+        switch(atom_gettype(argv)){
+            case A_LONG:
+                temp_sl = atom_getlong(argv);
+                break;
+            case A_FLOAT:
+                temp_sl = (long)atom_getfloat(argv);
+                break;
+            default:
+                object_error((t_object *)x, "bad value for series_length");
+                return;
+                break;
+        }
+
+        
+        if(temp_sl > ((2 * x->core.pattern_length) + 1) && temp_sl != x->core.series_max_length) {
+            long dims = x->core.series_vector_size;
+            void* scratch = sc_util_apen_scratch_new(temp_sl, dims);
+            long ok = 0;
+            critical_enter(x->lock);
+            if(scratch) {
+                ok = sc_util_apen_core_set_max_length(&x->core, temp_sl);
+            }
+            if(ok) {
+                sc_util_apen_scratch_set(x, scratch, temp_sl, dims);
+                scratch = NULL;
+            }
+            for(long c = 1; ok && c < x->channels; c++) {
+                if(!sc_util_apen_core_set_max_length(sc_util_apen_channel(x, c), temp_sl)) {
+                    object_error((t_object *)x, "could not allocate a series of length %ld for channel %ld", temp_sl, c + 1);
+                }
+            }
+            critical_exit(x->lock);
+            if(scratch) {
+                sysmem_freeptr(scratch);
+            }
+            if(!ok) {
+                object_error((t_object *)x, "could not allocate a series of length %ld", temp_sl);
+            }
+        } else if(temp_sl != x->core.series_max_length){
+            object_error((t_object *)x, "Series length too short, must >= %ld", (2 * x->core.pattern_length) + 1);
+        }
+    }
+}
+
+void sc_util_apen_get_series_length(t_sc_util_apen *x, t_object *attr, long *argc, t_atom **argv){
+    char alloc;
+    long sl = 0;
+    
+    atom_alloc(argc, argv, &alloc);
+    sl = x->core.series_max_length;
     atom_setlong(*argv, sl);
 }
 
@@ -516,7 +1437,30 @@ void sc_util_apen_set_vector_size(t_sc_util_apen *x, void *attr, long argc, t_at
                 break;
         }
         if(temp_vs > 0) {
-            x->series_vector_size = 1;
+            //the stored vectors no longer have the right size, the core starts a new series
+            long max = x->core.series_max_length;
+            void* scratch = sc_util_apen_scratch_new(max, temp_vs);
+            long ok = 0;
+            critical_enter(x->lock);
+            if(scratch) {
+                ok = sc_util_apen_core_set_vector_size(&x->core, temp_vs);
+            }
+            if(ok) {
+                sc_util_apen_scratch_set(x, scratch, max, temp_vs);
+                scratch = NULL;
+            }
+            for(long c = 1; ok && c < x->channels; c++) {
+                if(!sc_util_apen_core_set_vector_size(sc_util_apen_channel(x, c), temp_vs)) {
+                    object_error((t_object *)x, "could not allocate a series of vector_size %ld for channel %ld", temp_vs, c + 1);
+                }
+            }
+            critical_exit(x->lock);
+            if(scratch) {
+                sysmem_freeptr(scratch);
+            }
+            if(!ok) {
+                object_error((t_object *)x, "could not allocate a series of vector_size %ld", temp_vs);
+            }
         } else {
             object_error((t_object *)x, "Vector Size must be a positive integer");
         }
@@ -528,7 +1472,7 @@ void sc_util_apen_get_vector_size(t_sc_util_apen *x, t_object *attr, long *argc,
     long vs = 0;
     
     atom_alloc(argc, argv, &alloc);
-    vs = x->series_vector_size;
+    vs = x->core.series_vector_size;
     atom_setlong(*argv, vs);
 }
 
@@ -550,10 +1494,14 @@ void sc_util_apen_pattern_length(t_sc_util_apen *x, void *attr, long argc, t_ato
                 break;
         }
         
-        if(temp_pl <= (x->series_max_length / 2) - 1 && temp_pl > 1){
-            x->pattern_length = temp_pl;
-        } else if(temp_pl > (x->series_max_length / 2) - 1){
-            object_error((t_object *)x, "pattern_length must be <= %d", (x->series_max_length / 2) - 1);
+        if(temp_pl <= (x->core.series_max_length / 2) - 1 && temp_pl > 1){
+            critical_enter(x->lock);
+            for(long c = 0; c < x->channels; c++) {
+                sc_util_apen_core_set_pattern_length(sc_util_apen_channel(x, c), temp_pl);
+            }
+            critical_exit(x->lock);
+        } else if(temp_pl > (x->core.series_max_length / 2) - 1){
+            object_error((t_object *)x, "pattern_length must be <= %ld", (x->core.series_max_length / 2) - 1);
         } else {
             object_error((t_object *)x, "pattern_length must be an integer > 1");
         }
@@ -565,7 +1513,7 @@ void sc_util_apen_get_pattern_length(t_sc_util_apen *x, t_object *attr, long *ar
     long pl = 0;
     
     atom_alloc(argc, argv, &alloc);
-    pl = x->pattern_length;
+    pl = x->core.pattern_length;
     atom_setlong(*argv, pl);
 }
 
@@ -575,7 +1523,11 @@ void sc_util_apen_similarity(t_sc_util_apen *x, void *attr, long argc, t_atom *a
         double temp_sim = atom_getfloat(argv);
         
         if(temp_sim > 0.0) {
-            x->similarity = temp_sim;
+            critical_enter(x->lock);
+            for(long c = 0; c < x->channels; c++) {
+                sc_util_apen_core_set_similarity(sc_util_apen_channel(x, c), temp_sim);
+            }
+            critical_exit(x->lock);
         } else {
             object_error((t_object *)x, "Similarity must be > 0.0, received %f", temp_sim);
         }
@@ -588,10 +1540,58 @@ void sc_util_apen_get_similarity(t_sc_util_apen *x,  t_object *attr, long *argc,
     double sim = 0.0;
     
     atom_alloc(argc, argv, &alloc);
-    sim = x->similarity;
+    sim = x->core.similarity_factor;
     atom_setfloat(*argv, sim);
 }
 
+//sets whether similarity is r itself or k, with r = k * the standard deviation of the series, by name or by index
+/* In relative mode every channel keeps a running mean and variance of its series, updated as values enter and leave,
+ so r follows the input at O(1) per value. The match counts depend on r and are recounted by each calculation
+ instead of following the input.
+ */
+void sc_util_apen_set_similarity_mode(t_sc_util_apen *x, void *attr, long argc, t_atom *argv){
+    if(argc && argv) {
+        long temp_mode = -1;
+        
+        switch(atom_gettype(argv)) {
+            case A_LONG:
+                temp_mode = atom_getlong(argv);
+                break;
+            case A_FLOAT:
+                temp_mode = (long)atom_getfloat(argv);
+                break;
+            case A_SYM:
+                if(atom_getsym(argv) == gensym("absolute")) {
+                    temp_mode = SC_UTIL_APEN_SIMILARITY_ABSOLUTE;
+                } else if(atom_getsym(argv) == gensym("relative")) {
+                    temp_mode = SC_UTIL_APEN_SIMILARITY_RELATIVE;
+                }
+                break;
+            default:
+                break;
+        }
+        if(temp_mode < SC_UTIL_APEN_SIMILARITY_ABSOLUTE || temp_mode > SC_UTIL_APEN_SIMILARITY_RELATIVE) {
+            object_error((t_object *)x, "similarity_mode must be absolute or relative");
+            return;
+        }
+        
+        critical_enter(x->lock);
+        for(long c = 0; c < x->channels; c++) {
+            sc_util_apen_core_set_similarity_mode(sc_util_apen_channel(x, c), temp_mode);
+        }
+        critical_exit(x->lock);
+    }
+}
+
+void sc_util_apen_get_similarity_mode(t_sc_util_apen *x, t_object *attr, long *argc, t_atom **argv){
+    char alloc;
+    long sm = 0;
+    
+    atom_alloc(argc, argv, &alloc);
+    sm = x->core.similarity_mode;
+    atom_setlong(*argv, sm);
+}
+
 //sets whether or not to attempt calculating ApEn when a new data point is received
 void sc_util_apen_calc_on_input(t_sc_util_apen *x, void *attr, long argc, t_atom *argv){
     if(argv && argc) {
@@ -630,7 +1630,7 @@ void sc_util_apen_get_cur_size(t_sc_util_apen *x, t_object *attr, long *argc, t_
     long csize = 0;
     
     atom_alloc(argc, argv, &alloc);
-    csize = x->series_length;
+    csize = x->core.series_length;
     atom_setlong(*argv, csize);
 }
 
@@ -671,6 +1671,445 @@ void sc_util_apen_get_size_warning(t_sc_util_apen *x, t_object *attr, long *argc
     atom_setlong(*argv, sw);
 }
 
+//sets whether match counts are updated as each value enters and leaves the series
+void sc_util_apen_set_incremental(t_sc_util_apen *x, void *attr, long argc, t_atom *argv){
+    if(argc && argv) {
+        long temp_inc = 0;
+        
+        switch(atom_gettype(argv)) {
+            case A_LONG:
+                temp_inc = atom_getlong(argv);
+                break;
+            case A_FLOAT:
+                temp_inc = (long)atom_getfloat(argv);
+                break;
+            default:
+                object_error((t_object *)x, "bad value received for incremental");
+                return;
+                break;
+        }
+        if(temp_inc >= 1) {temp_inc = 1;}
+        if(temp_inc <= 0) {temp_inc = 0;}
+        
+        critical_enter(x->lock);
+        x->incremental = temp_inc;
+        //counts are not kept up to date on input while async is on
+        for(long c = 0; c < x->channels; c++) {
+            sc_util_apen_core_set_incremental(sc_util_apen_channel(x, c), x->incremental && !x->async);
+        }
+        critical_exit(x->lock);
+    }
+}
+
+void sc_util_apen_get_incremental(t_sc_util_apen *x, t_object *attr, long *argc, t_atom **argv){
+    char alloc;
+    long inc = 0;
+    
+    atom_alloc(argc, argv, &alloc);
+    inc = x->incremental;
+    atom_setlong(*argv, inc);
+}
+
+//sets whether ApEn is calculated on a worker thread instead of the thread that delivered the input
+/* While async is on, incoming values are only stored, the match counts are not updated on input,
+ so the thread delivering data never does more than copy a value.
+ */
+void sc_util_apen_set_async(t_sc_util_apen *x, void *attr, long argc, t_atom *argv){
+    if(argc && argv) {
+        long temp_async = 0;
+        
+        switch(atom_gettype(argv)) {
+            case A_LONG:
+                temp_async = atom_getlong(argv);
+                break;
+            case A_FLOAT:
+                temp_async = (long)atom_getfloat(argv);
+                break;
+            default:
+                object_error((t_object *)x, "bad value received for async");
+                return;
+                break;
+        }
+        if(temp_async >= 1) {temp_async = 1;}
+        if(temp_async <= 0) {temp_async = 0;}
+        
+        if(temp_async && !x->worker) {
+            x->worker_quit = 0;
+            x->worker_pending = 0;
+            if(systhread_create((method)sc_util_apen_worker, x, 0, 0, 0, &x->worker)) {
+                x->worker = NULL;
+                object_error((t_object *)x, "could not start the worker thread, async stays off");
+                return;
+            }
+        }
+        
+        critical_enter(x->lock);
+        x->async = temp_async;
+        for(long c = 0; c < x->channels; c++) {
+            sc_util_apen_core_set_incremental(sc_util_apen_channel(x, c), x->incremental && !x->async);
+        }
+        critical_exit(x->lock);
+    }
+}
+
+void sc_util_apen_get_async(t_sc_util_apen *x, t_object *attr, long *argc, t_atom **argv){
+    char alloc;
+    long as = 0;
+    
+    atom_alloc(argc, argv, &alloc);
+    as = x->async;
+    atom_setlong(*argv, as);
+}
+
+//sets which estimators are calculated, by name or by index
+void sc_util_apen_set_mode(t_sc_util_apen *x, void *attr, long argc, t_atom *argv){
+    if(argc && argv) {
+        long temp_mode = -1;
+        t_symbol* name = NULL;
+        
+        switch(atom_gettype(argv)) {
+            case A_LONG:
+                temp_mode = atom_getlong(argv);
+                break;
+            case A_FLOAT:
+                temp_mode = (long)atom_getfloat(argv);
+                break;
+            case A_SYM:
+                name = atom_getsym(argv);
+                if(name == gensym("apen")) {
+                    temp_mode = SC_UTIL_APEN_MODE_APEN;
+                } else if(name == gensym("sampen")) {
+                    temp_mode = SC_UTIL_APEN_MODE_SAMPEN;
+                } else if(name == gensym("fuzzyen")) {
+                    temp_mode = SC_UTIL_APEN_MODE_FUZZYEN;
+                } else if(name == gensym("combined")) {
+                    temp_mode = SC_UTIL_APEN_MODE_COMBINED;
+                } else if(name == gensym("all")) {
+                    temp_mode = SC_UTIL_APEN_MODE_ALL;
+                }
+                break;
+            default:
+                object_error((t_object *)x, "bad value received for mode");
+                return;
+                break;
+        }
+        
+        if(temp_mode >= SC_UTIL_APEN_MODE_APEN && temp_mode <= SC_UTIL_APEN_MODE_ALL) {
+            critical_enter(x->lock);
+            x->mode = temp_mode;
+            critical_exit(x->lock);
+        } else {
+            object_error((t_object *)x, "mode must be apen, sampen, fuzzyen, combined or all");
+        }
+    }
+}
+
+void sc_util_apen_get_mode(t_sc_util_apen *x, t_object *attr, long *argc, t_atom **argv){
+    char alloc;
+    long md = 0;
+    
+    atom_alloc(argc, argv, &alloc);
+    md = x->mode;
+    atom_setlong(*argv, md);
+}
+
+//sets the number of scales for multiscale entropy
+void sc_util_apen_set_scales(t_sc_util_apen *x, void *attr, long argc, t_atom *argv){
+    if(argc && argv) {
+        long temp_sc = 0;
+        
+        switch(atom_gettype(argv)) {
+            case A_LONG:
+                temp_sc = atom_getlong(argv);
+                break;
+            case A_FLOAT:
+                temp_sc = (long)atom_getfloat(argv);
+                break;
+            default:
+                object_error((t_object *)x, "bad value received for scales");
+                return;
+                break;
+        }
+        
+        if(temp_sc >= 1 && temp_sc <= SC_UTIL_APEN_MAX_SCALES) {
+            critical_enter(x->lock);
+            x->scales = temp_sc;
+            critical_exit(x->lock);
+        } else {
+            object_error((t_object *)x, "scales must be between 1 and %d", SC_UTIL_APEN_MAX_SCALES);
+        }
+    }
+}
+
+void sc_util_apen_get_scales(t_sc_util_apen *x, t_object *attr, long *argc, t_atom **argv){
+    char alloc;
+    long sc = 0;
+    
+    atom_alloc(argc, argv, &alloc);
+    sc = x->scales;
+    atom_setlong(*argv, sc);
+}
+
+//sets the number of reference windows a calculation samples
+/* With estimate > 0, series with more windows than that estimate ApEn and SampEn from that many windows picked at random,
+ at a cost of estimate * series_length comparisons instead of series_length^2 / 2, and the 95% confidence interval of ApEn
+ comes out the dumpout as confidence low high (for each scale). incremental is suspended while estimate is set, so the
+ same series and estimate_seed give the same value whatever was changed before. FuzzyEn is never sampled.
+ */
+void sc_util_apen_set_estimate(t_sc_util_apen *x, void *attr, long argc, t_atom *argv){
+    if(argc && argv) {
+        long temp_es = 0;
+        
+        switch(atom_gettype(argv)) {
+            case A_LONG:
+                temp_es = atom_getlong(argv);
+                break;
+            case A_FLOAT:
+                temp_es = (long)atom_getfloat(argv);
+                break;
+            default:
+                object_error((t_object *)x, "bad value received for estimate");
+                return;
+                break;
+        }
+        
+        if(temp_es >= 0) {
+            critical_enter(x->lock);
+            for(long c = 0; c < x->channels; c++) {
+                sc_util_apen_core_set_estimate(sc_util_apen_channel(x, c), temp_es, x->core.estimate_seed);
+            }
+            critical_exit(x->lock);
+        } else {
+            object_error((t_object *)x, "estimate must be an integer >= 0");
+        }
+    }
+}
+
+void sc_util_apen_get_estimate(t_sc_util_apen *x, t_object *attr, long *argc, t_atom **argv){
+    char alloc;
+    long es = 0;
+    
+    atom_alloc(argc, argv, &alloc);
+    es = x->core.estimate_samples;
+    atom_setlong(*argv, es);
+}
+
+//sets the seed choosing the sampled windows, the same seed and series always give the same estimate
+void sc_util_apen_set_estimate_seed(t_sc_util_apen *x, void *attr, long argc, t_atom *argv){
+    if(argc && argv) {
+        long temp_seed = 0;
+        
+        switch(atom_gettype(argv)) {
+            case A_LONG:
+                temp_seed = atom_getlong(argv);
+                break;
+            case A_FLOAT:
+                temp_seed = (long)atom_getfloat(argv);
+                break;
+            default:
+                object_error((t_object *)x, "bad value received for estimate_seed");
+                return;
+                break;
+        }
+        
+        critical_enter(x->lock);
+        for(long c = 0; c < x->channels; c++) {
+            sc_util_apen_core_set_estimate(sc_util_apen_channel(x, c), x->core.estimate_samples, (unsigned long)temp_seed);
+        }
+        critical_exit(x->lock);
+    }
+}
+
+void sc_util_apen_get_estimate_seed(t_sc_util_apen *x, t_object *attr, long *argc, t_atom **argv){
+    char alloc;
+    long seed = 0;
+    
+    atom_alloc(argc, argv, &alloc);
+    seed = (long)x->core.estimate_seed;
+    atom_setlong(*argv, seed);
+}
+
+//sets the number of new values needed before calculate_on_input calculates again
+void sc_util_apen_set_hop_size(t_sc_util_apen *x, void *attr, long argc, t_atom *argv){
+    if(argc && argv) {
+        long temp_hop = 0;
+        
+        switch(atom_gettype(argv)) {
+            case A_LONG:
+                temp_hop = atom_getlong(argv);
+                break;
+            case A_FLOAT:
+                temp_hop = (long)atom_getfloat(argv);
+                break;
+            default:
+                object_error((t_object *)x, "bad value received for hop_size");
+                return;
+                break;
+        }
+        if(temp_hop >= 1) {
+            x->hop_size = temp_hop;
+        } else {
+            object_error((t_object *)x, "hop_size must be an integer >= 1");
+        }
+    }
+}
+
+void sc_util_apen_get_hop_size(t_sc_util_apen *x, t_object *attr, long *argc, t_atom **argv){
+    char alloc;
+    long hop = 0;
+    
+    atom_alloc(argc, argv, &alloc);
+    hop = x->hop_size;
+    atom_setlong(*argv, hop);
+}
+
+//sets the minimum time in ms between calculations triggered by calculate_on_input
+void sc_util_apen_set_calc_interval(t_sc_util_apen *x, void *attr, long argc, t_atom *argv){
+    if(argc && argv) {
+        double temp_int = atom_getfloat(argv);
+        
+        if(temp_int >= 0.0) {
+            x->calc_interval = temp_int;
+        } else {
+            object_error((t_object *)x, "calc_interval must be >= 0.0, received %f", temp_int);
+        }
+    }
+}
+
+void sc_util_apen_get_calc_interval(t_sc_util_apen *x, t_object *attr, long *argc, t_atom **argv){
+    char alloc;
+    double ci = 0.0;
+    
+    atom_alloc(argc, argv, &alloc);
+    ci = x->calc_interval;
+    atom_setfloat(*argv, ci);
+}
+
+//sets the number of independent series
+/* Every channel has its own series, match counts and work memory with the settings of channel 1.
+ Channels that remain keep their series, new channels start empty. The pool gets one thread less
+ than the number of processors, at most one per channel, as the thread starting a batch works on it too.
+ */
+void sc_util_apen_set_channels(t_sc_util_apen *x, void *attr, long argc, t_atom *argv){
+    if(argc && argv) {
+        long temp_ch = 0;
+        
+        switch(atom_gettype(argv)) {
+            case A_LONG:
+                temp_ch = atom_getlong(argv);
+                break;
+            case A_FLOAT:
+                temp_ch = (long)atom_getfloat(argv);
+                break;
+            default:
+                object_error((t_object *)x, "bad value received for channels");
+                return;
+                break;
+        }
+        if(temp_ch < 1 || temp_ch > SC_UTIL_APEN_MAX_CHANNELS) {
+            object_error((t_object *)x, "channels must be an integer from 1 to %d", SC_UTIL_APEN_MAX_CHANNELS);
+            return;
+        }
+        if(temp_ch == x->channels) {
+            return;
+        }
+        
+        long old = x->channels;
+        t_sc_util_apen_core* cores = NULL;
+        double* result = NULL;
+        double* output = NULL;
+        t_atom* atoms = NULL;
+        if(temp_ch > 1) {
+            long ok = 1;
+            cores = (t_sc_util_apen_core*)sysmem_newptr(sizeof(t_sc_util_apen_core) * (temp_ch - 1));
+            result = (double*)sysmem_newptr(sizeof(double) * SC_UTIL_APEN_CHANNEL_RESULT * temp_ch);
+            output = (double*)sysmem_newptr(sizeof(double) * SC_UTIL_APEN_CHANNEL_RESULT * temp_ch);
+            atoms = (t_atom*)sysmem_newptr(sizeof(t_atom) * 2 * SC_UTIL_APEN_CHANNEL_RESULT * temp_ch);
+            ok = (cores && result && output && atoms);
+            
+            //new channels are made outside of the lock, input keeps arriving on the others meanwhile
+            long first = (old > 1) ? old : 1;
+            for(long c = first; ok && c < temp_ch; c++) {
+                t_sc_util_apen_core* core = cores + c - 1;
+                if(!sc_util_apen_core_init(core, x->core.series_max_length, x->core.series_vector_size)) {
+                    for(long k = first; k < c; k++) {
+                        sc_util_apen_core_free(cores + k - 1);
+                    }
+                    ok = 0;
+                    break;
+                }
+                sc_util_apen_core_set_pattern_length(core, x->core.pattern_length);
+                sc_util_apen_core_set_similarity(core, x->core.similarity_factor);
+                sc_util_apen_core_set_similarity_mode(core, x->core.similarity_mode);
+                sc_util_apen_core_set_estimate(core, x->core.estimate_samples, x->core.estimate_seed);
+                sc_util_apen_core_set_incremental(core, x->incremental && !x->async);
+            }
+            if(!ok) {
+                if(cores) {
+                    sysmem_freeptr(cores);
+                }
+                if(result) {
+                    sysmem_freeptr(result);
+                }
+                if(output) {
+                    sysmem_freeptr(output);
+                }
+                if(atoms) {
+                    sysmem_freeptr(atoms);
+                }
+                object_error((t_object *)x, "could not allocate %ld channels", temp_ch);
+                return;
+            }
+        }
+        
+        critical_enter(x->lock);
+        sc_util_apen_pool_stop(x);
+        for(long c = 1; c < old; c++) {
+            if(c < temp_ch) {
+                cores[c - 1] = x->channel_cores[c - 1];
+            } else {
+                sc_util_apen_core_free(x->channel_cores + c - 1);
+            }
+        }
+        if(x->channel_cores) {
+            sysmem_freeptr(x->channel_cores);
+            sysmem_freeptr(x->channel_result);
+        }
+        x->channel_cores = cores;
+        x->channel_result = result;
+        //the lists replaced may still be going out below the outlet, they are only freed with the next ones
+        if(x->channel_atoms_retired) {
+            sysmem_freeptr(x->channel_atoms_retired);
+        }
+        x->channel_atoms_retired = x->channel_atoms;
+        x->channel_atoms = atoms;
+        
+        systhread_mutex_lock(x->worker_mutex);
+        if(x->channel_output) {
+            sysmem_freeptr(x->channel_output);
+        }
+        x->channel_output = output;
+        x->worker_channels = 0;
+        systhread_mutex_unlock(x->worker_mutex);
+        
+        x->channels = temp_ch;
+        if(temp_ch > 1) {
+            long threads = sc_util_apen_cpu_count();
+            sc_util_apen_pool_start(x, ((temp_ch < threads) ? temp_ch : threads) - 1);
+        }
+        critical_exit(x->lock);
+    }
+}
+
+void sc_util_apen_get_channels(t_sc_util_apen *x, t_object *attr, long *argc, t_atom **argv){
+    char alloc;
+    long ch = 0;
+    
+    atom_alloc(argc, argv, &alloc);
+    ch = x->channels;
+    atom_setlong(*argv, ch);
+}
+
 
 void *sc_util_apen_new(t_symbol *s, long argc, t_atom *argv)
 {
@@ -681,16 +2120,89 @@ void *sc_util_apen_new(t_symbol *s, long argc, t_atom *argv)
         //Set initial values
         x->calc_on_input = 1;
         x->hold_size_warning = 1;
-        x->pattern_length = 3;
-        x->series_length = 0;
-        x->series_vector_size = 1; //for N-D vectors
-        x->series_max_length = 50;
-        x->similarity = 1.0;
+        x->incremental = 1;
+        //each object has its own lock so objects never wait on each other's input or calculations
+        critical_new(&x->lock);
 		x->out = outlet_new(x, 0L);
         x->out2 = outlet_new(x, NULL);
         
-        //allocate memory for the initial data series
-        x->test_value = (double*)sysmem_newptr(sizeof(double) * x->series_max_length);
+        //allocate memory for the initial data series, 50 values of vector_size 1 with pattern_length 3 and similarity 1.0
+        x->scratch = NULL;
+        x->scratch_retired = NULL;
+        x->list_values = NULL;
+        x->dump_atoms = NULL;
+        x->dump_turn = 0;
+        if(!sc_util_apen_core_init(&x->core, 50, 1)) {
+            object_error((t_object *)x, "could not allocate the series");
+        }
+        sc_util_apen_scratch_set(x, sc_util_apen_scratch_new(50, 1), 50, 1);
+        
+        //calculate on every value with no time limit until hop_size or calc_interval are set
+        x->hop_size = 1;
+        x->calc_interval = 0.0;
+        x->samples_since_calc = 0;
+        x->last_calc_time = 0.0;
+        x->calc_scheduled = 0;
+        x->calc_clock = clock_new(x, (method)sc_util_apen_tick);
+        
+        //the worker thread is only started if async is turned on
+        x->async = 0;
+        x->mode = SC_UTIL_APEN_MODE_APEN;
+        x->scales = 1;
+        x->channels = 1;
+        x->channel_cores = NULL;
+        x->channel_result = NULL;
+        x->channel_output = NULL;
+        x->channel_atoms = NULL;
+        x->channel_turn = 0;
+        x->channel_atoms_retired = NULL;
+        x->pool = NULL;
+        x->pool_size = 0;
+        x->pool_batch = 0;
+        x->pool_channels = 0;
+        x->pool_next = 0;
+        x->pool_done = 0;
+        x->pool_short = 0;
+        x->pool_mode = SC_UTIL_APEN_MODE_APEN;
+        x->pool_scales = 1;
+        x->pool_cores = NULL;
+        x->pool_result = NULL;
+        x->pool_busy = 0;
+        x->pool_quit = 0;
+        systhread_mutex_new(&x->pool_mutex, 0);
+        systhread_cond_new(&x->pool_cond, 0);
+        systhread_cond_new(&x->pool_done_cond, 0);
+        x->analysis_output = gensym("");
+        x->analysis_dict = NULL;
+        x->stat_last_time = 0.0;
+        x->stat_total_time = 0.0;
+        x->stat_calculations = 0;
+        x->stat_inputs = 0;
+        x->stat_skipped = 0;
+        x->stat_coalesced = 0;
+        x->worker = NULL;
+        x->worker_pending = 0;
+        x->worker_quit = 0;
+        for(int i = 0; i < 3 * SC_UTIL_APEN_MAX_SCALES; i++) {
+            x->worker_result[i] = 0.0;
+        }
+        x->worker_mode = SC_UTIL_APEN_MODE_APEN;
+        x->worker_scales = 1;
+        x->worker_estimate = 0;
+        x->worker_channels = 0;
+        x->worker_series = NULL;
+        x->worker_count0 = NULL;
+        x->worker_count1 = NULL;
+        x->worker_capacity = 0;
+        x->worker_dims = 0;
+        x->worker_scale_buffer = NULL;
+        x->worker_cores = NULL;
+        x->worker_core_count = 0;
+        x->worker_channel_result = NULL;
+        x->worker_work = NULL;
+        systhread_mutex_new(&x->worker_mutex, 0);
+        systhread_cond_new(&x->worker_cond, 0);
+        x->worker_qelem = qelem_new(x, (method)sc_util_apen_worker_output);
         
         //process arguments typed into object box
         attr_args_process(x, argc, argv);
@@ -705,104 +2217,674 @@ void *sc_util_apen_new(t_symbol *s, long argc, t_atom *argv)
 
 void sc_util_apen_calculate(t_sc_util_apen *x) {
     
+    //restart the hop_size and calc_interval throttling from this calculation
+    critical_enter(x->lock);
+    x->samples_since_calc = 0;
+    clock_getftime(&x->last_calc_time);
+    long channels = x->channels;
+    long length = x->core.series_length;
+    long needed = x->core.pattern_length * 2;
+    critical_exit(x->lock);
+    
+    if(channels > 1) {
+        if(x->async) {
+            sc_util_apen_request(x);
+        } else {
+            sc_util_apen_calculate_channels(x);
+        }
+        return;
+    }
+    
     //check to make sure there is enough stored data to get meaningful results
-    if(x->series_length < x->pattern_length * 2) {
+    if(length < needed) {
         //check if the user has declined to have warnings sent to the console when there is insufficient data
         if(x->hold_size_warning == 1){ //warn user of insufficient data
             object_warn((t_object*)x, "Not enough data to calculate approximate entropy.");
-            object_warn((t_object*)x, "Need %d data points, have %d", x->pattern_length * 2, x->series_length);
+            object_warn((t_object*)x, "Need %ld data points, have %ld", needed, length);
             object_warn((t_object*)x, "Outputting default value of 0.");
-            outlet_float(x->out2, 0.0);
+            double zero[3 * SC_UTIL_APEN_MAX_SCALES] = {0.0};
+            sc_util_apen_output(x, x->mode, x->scales, zero);
         }
         //exit function, do not attempt to calculate
         return;
+    } else if(x->async) {
+        //hand the calculation to the worker thread, the result comes out of sc_util_apen_worker_output
+        sc_util_apen_request(x);
     } else {
         
-        //STEP 1 : Compute for pattern length
-        double m0[x->series_length - x->pattern_length + 1]; //array for holding number of windows within similarity index of current window
-        double avg_ratio0 = 0; //average number of windows within the similarity index for Cm(0...i)
-        
-        //temporary pointer to the data set
-        double* temp = x->test_value;
-        
-        //outer loop for iterating through each possible window included in the data set of size m (pattern length)
-        for(int i = 0; i < x->series_length - x->pattern_length + 1; i++, temp++) {
-            m0[i] = 0.0; //initialize current index value
-            double* temp2 = x->test_value; //second temporary pointer to data set
-            //inner loop, iterate through all possible windows of size m to compare against the current window from the outer loop
-            for(int j = 0; j < x->series_length - x->pattern_length + 1; j++, temp2++) {
-                //compute the maximum distance between elements in both windows, add 1 to the index value if lees than or equal to similarity index
-                m0[i] += (sc_util_apen_maxdist(temp, temp2, x->pattern_length, x->similarity) <= x->similarity) ? 1 : 0;
-            }
-            //get the percent of windows similar enough (total # of similar windows / total number of windows)
-            m0[i] /= (x->series_length - x->pattern_length) + 1;
-            //add to the average variable
-            avg_ratio0 += m0[i];
-        }
-        //take the average percentage (Ci(m))
-        avg_ratio0 /= (x->series_length - x->pattern_length) + 1;
-        
-        //STEP 2 : Compute for pattern length + 1
-        double m1[x->series_length - (x->pattern_length + 1) + 1];
-        double avg_ratio1 = 0;
-        temp = x->test_value;
-        for(int i = 0; i < x->series_length - (x->pattern_length + 1) + 1; i++, temp++) {
-            m1[i] = 0;
-            double* temp2 = x->test_value;
-            for(int j = 0; j < x->series_length - (x->pattern_length + 1) + 1; j++, temp2++){
-                m1[i] += (sc_util_apen_maxdist(temp, temp2, x->pattern_length + 1, x->similarity) <= x->similarity) ? 1 : 0;
+        double result[3 * SC_UTIL_APEN_MAX_SCALES];
+        double ci[2 * SC_UTIL_APEN_MAX_SCALES];
+        long mode = x->mode;
+        long scales = x->scales;
+
+        critical_enter(x->lock);
+        double start = systimer_gettime();
+        sc_util_apen_core_calculate(&x->core, mode, scales, result);
+        x->stat_last_time = systimer_gettime() - start;
+        x->stat_total_time += x->stat_last_time;
+        x->stat_calculations++;
+        long estimate = x->core.estimate_samples;
+        sysmem_copyptr(x->core.ci, ci, sizeof(double) * 2 * scales);
+        critical_exit(x->lock);
+
+        //outlet the value to the user, the confidence interval first as the dumpout is to the right
+        if(estimate > 0 && mode != SC_UTIL_APEN_MODE_FUZZYEN) {
+            sc_util_apen_output_confidence(x, scales, ci);
+        }
+        sc_util_apen_output(x, mode, scales, result);
+    }
+}
+
+//sends the values mode asks for out the left outlet, a float for a single estimator and a list otherwise
+/* With scales > 1 the list holds the values mode asks for at scale 1, then at scale 2 and so on. */
+void sc_util_apen_output(t_sc_util_apen *x, long mode, long scales, double* result) {
+    t_atom list[3 * SC_UTIL_APEN_MAX_SCALES];
+    long n = sc_util_apen_output_atoms(mode, scales, result, list);
+
+    if(n == 1) {
+        outlet_float(x->out2, atom_getfloat(list));
+    } else {
+        outlet_list(x->out2, 0L, n, list);
+    }
+}
+
+//sends confidence low high out the dumpout, one pair for each scale
+/* For a calculation that counted every window (the series was shorter than estimate, or the counts were kept
+ up to date) both ends are the ApEn value itself.
+ */
+void sc_util_apen_output_confidence(t_sc_util_apen *x, long scales, double* ci) {
+    t_atom list[2 * SC_UTIL_APEN_MAX_SCALES];
+    
+    for(int i = 0; i < 2 * scales; i++) {
+        atom_setfloat(list + i, ci[i]);
+    }
+    outlet_anything(x->out, gensym("confidence"), 2 * scales, list);
+}
+
+long sc_util_apen_output_atoms(long mode, long scales, double* result, t_atom* list) {
+    long n = 0;
+
+    for(int s = 0; s < scales; s++) {
+        double* res = result + 3 * s;
+        switch(mode) {
+            case SC_UTIL_APEN_MODE_SAMPEN:
+                atom_setfloat(list + n++, res[1]);
+                break;
+            case SC_UTIL_APEN_MODE_FUZZYEN:
+                atom_setfloat(list + n++, res[2]);
+                break;
+            case SC_UTIL_APEN_MODE_COMBINED:
+                atom_setfloat(list + n++, res[0]);
+                atom_setfloat(list + n++, res[1]);
+                break;
+            case SC_UTIL_APEN_MODE_ALL:
+                atom_setfloat(list + n++, res[0]);
+                atom_setfloat(list + n++, res[1]);
+                atom_setfloat(list + n++, res[2]);
+                break;
+            default:
+                atom_setfloat(list + n++, res[0]);
+                break;
+        }
+    }
+    return n;
+}
+
+//makes the list output for every channel at once, the values of channel 1 followed by those of channel 2 and so on
+/* Each channel gives the values sc_util_apen_output would for it, result holds SC_UTIL_APEN_CHANNEL_RESULT values per channel.
+ The caller holds lock, and outputs the list once it has let go: objects below the outlet may send straight back into this one,
+ and their output fills the other list of channel_atoms.
+ */
+t_atom* sc_util_apen_channel_list(t_sc_util_apen *x, long channels, long mode, long scales, double* result, long* n) {
+    t_atom* list = x->channel_atoms + x->channel_turn * SC_UTIL_APEN_CHANNEL_RESULT * x->channels;
+    
+    x->channel_turn = !x->channel_turn;
+    *n = 0;
+    for(long c = 0; c < channels; c++) {
+        *n += sc_util_apen_output_atoms(mode, scales, result + c * SC_UTIL_APEN_CHANNEL_RESULT, list + *n);
+    }
+    return list;
+}
+
+//the series of channel c, counted from 0
+t_sc_util_apen_core* sc_util_apen_channel(t_sc_util_apen *x, long c) {
+    return c ? x->channel_cores + c - 1 : &x->core;
+}
+
+//calculates every channel on the pool and outputs them as one list
+/* Input waits for the whole batch, as it waits for a single calculation. Channels too short for
+ pattern_length give 0.
+ */
+void sc_util_apen_calculate_channels(t_sc_util_apen *x) {
+    long mode = x->mode;
+    long scales = x->scales;
+    
+    critical_enter(x->lock);
+    long channels = x->channels;
+    double start = systimer_gettime();
+    long short_channels = sc_util_apen_batch(x, NULL, channels, x->channel_result, mode, scales);
+    x->stat_last_time = systimer_gettime() - start;
+    x->stat_total_time += x->stat_last_time;
+    x->stat_calculations++;
+    
+    if(short_channels && x->hold_size_warning == 1) {
+        object_warn((t_object*)x, "Not enough data to calculate approximate entropy on %ld of %ld channels, need %ld data points.", short_channels, channels, x->core.pattern_length * 2);
+        object_warn((t_object*)x, "Outputting default value of 0 for them.");
+    }
+    
+    //outlet the values to the user once the lock is left
+    long n = 0;
+    t_atom* list = sc_util_apen_channel_list(x, channels, mode, scales, x->channel_result, &n);
+    critical_exit(x->lock);
+    
+    outlet_list(x->out2, 0L, n, list);
+}
+
+//calculates channels cores into result
+/* The calling thread announces the batch to the pool and then takes channels like any pool thread,
+ so the batch finishes even if no pool thread gets to run. Channels are handed out one at a time,
+ a slow channel only holds up the thread working on it. Each channel only touches its own core and
+ its own part of result. Without cores the channels themselves are calculated and the caller holds lock for all of them,
+ the worker's snapshots need no lock. A batch started while another runs waits for it.
+ */
+long sc_util_apen_batch(t_sc_util_apen *x, t_sc_util_apen_core* cores, long channels, double* result, long mode, long scales) {
+    systhread_mutex_lock(x->pool_mutex);
+    while(x->pool_busy) {
+        systhread_cond_wait(x->pool_done_cond, x->pool_mutex);
+    }
+    x->pool_busy = 1;
+    x->pool_cores = cores;
+    x->pool_result = result;
+    x->pool_mode = mode;
+    x->pool_scales = scales;
+    x->pool_channels = channels;
+    x->pool_next = 0;
+    x->pool_done = 0;
+    x->pool_short = 0;
+    x->pool_batch++;
+    systhread_cond_broadcast(x->pool_cond);
+    systhread_mutex_unlock(x->pool_mutex);
+    
+    sc_util_apen_batch_work(x);
+    
+    systhread_mutex_lock(x->pool_mutex);
+    while(x->pool_done < x->pool_channels) {
+        systhread_cond_wait(x->pool_done_cond, x->pool_mutex);
+    }
+    long short_channels = x->pool_short;
+    x->pool_busy = 0;
+    systhread_cond_broadcast(x->pool_done_cond);
+    systhread_mutex_unlock(x->pool_mutex);
+    
+    return short_channels;
+}
+
+void sc_util_apen_batch_work(t_sc_util_apen *x) {
+    while(1) {
+        systhread_mutex_lock(x->pool_mutex);
+        long c = x->pool_next++;
+        long channels = x->pool_channels;
+        long mode = x->pool_mode;
+        long scales = x->pool_scales;
+        t_sc_util_apen_core* core = x->pool_cores ? x->pool_cores + c : sc_util_apen_channel(x, c);
+        double* result = x->pool_result + c * SC_UTIL_APEN_CHANNEL_RESULT;
+        systhread_mutex_unlock(x->pool_mutex);
+        if(c >= channels) {
+            break;
+        }
+        
+        long ok = sc_util_apen_core_calculate(core, mode, scales, result);
+        
+        systhread_mutex_lock(x->pool_mutex);
+        if(!ok) {
+            x->pool_short++;
+        }
+        x->pool_done++;
+        if(x->pool_done == channels) {
+            systhread_cond_broadcast(x->pool_done_cond);
+        }
+        systhread_mutex_unlock(x->pool_mutex);
+    }
+}
+
+void *sc_util_apen_pool_thread(t_sc_util_apen *x) {
+    systhread_mutex_lock(x->pool_mutex);
+    long seen = x->pool_batch;
+    systhread_mutex_unlock(x->pool_mutex);
+    
+    while(1) {
+        systhread_mutex_lock(x->pool_mutex);
+        while(x->pool_batch == seen && !x->pool_quit) {
+            systhread_cond_wait(x->pool_cond, x->pool_mutex);
+        }
+        if(x->pool_quit) {
+            systhread_mutex_unlock(x->pool_mutex);
+            break;
+        }
+        seen = x->pool_batch;
+        systhread_mutex_unlock(x->pool_mutex);
+        
+        sc_util_apen_batch_work(x);
+    }
+    
+    systhread_exit(0);
+    return NULL;
+}
+
+//starts size pool threads, fewer if the system will not make them, batches still finish on the calling thread
+void sc_util_apen_pool_start(t_sc_util_apen *x, long size) {
+    if(size < 1) {
+        return;
+    }
+    x->pool = (t_systhread*)sysmem_newptr(sizeof(t_systhread) * size);
+    if(!x->pool) {
+        return;
+    }
+    x->pool_quit = 0;
+    x->pool_size = 0;
+    for(long i = 0; i < size; i++) {
+        if(systhread_create((method)sc_util_apen_pool_thread, x, 0, 0, 0, x->pool + i)) {
+            break;
+        }
+        x->pool_size++;
+    }
+}
+
+void sc_util_apen_pool_stop(t_sc_util_apen *x) {
+    if(!x->pool) {
+        return;
+    }
+    
+    systhread_mutex_lock(x->pool_mutex);
+    x->pool_quit = 1;
+    systhread_cond_broadcast(x->pool_cond);
+    systhread_mutex_unlock(x->pool_mutex);
+    
+    for(long i = 0; i < x->pool_size; i++) {
+        unsigned int ret;
+        systhread_join(x->pool[i], &ret);
+    }
+    sysmem_freeptr(x->pool);
+    x->pool = NULL;
+    x->pool_size = 0;
+    x->pool_quit = 0;
+}
+
+long sc_util_apen_cpu_count(void) {
+#ifdef WIN_VERSION
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    long count = (long)info.dwNumberOfProcessors;
+#else
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+    return (count > 0) ? count : 1;
+}
+
+//asks the worker thread for a calculation
+/* The worker takes its snapshot of the series when it starts a calculation, so any number of requests made
+ while a calculation is running collapse into a single new calculation on the latest data.
+ */
+void sc_util_apen_request(t_sc_util_apen *x) {
+    systhread_mutex_lock(x->worker_mutex);
+    long merged = x->worker_pending;
+    x->worker_pending = 1;
+    systhread_cond_signal(x->worker_cond);
+    systhread_mutex_unlock(x->worker_mutex);
+    
+    if(merged) {
+        critical_enter(x->lock);
+        x->stat_coalesced++;
+        critical_exit(x->lock);
+    }
+}
+
+void *sc_util_apen_worker(t_sc_util_apen *x) {
+    while(1) {
+        systhread_mutex_lock(x->worker_mutex);
+        while(!x->worker_pending && !x->worker_quit) {
+            systhread_cond_wait(x->worker_cond, x->worker_mutex);
+        }
+        if(x->worker_quit) {
+            systhread_mutex_unlock(x->worker_mutex);
+            break;
+        }
+        x->worker_pending = 0;
+        systhread_mutex_unlock(x->worker_mutex);
+        
+        //snapshot the series and parameters, the input threads only wait for the copy
+        critical_enter(x->lock);
+        if(x->channels > 1) {
+            sc_util_apen_worker_channels(x);
+            continue;
+        }
+        long snapshot = sc_util_apen_worker_alloc(x);
+        long length = x->core.series_length;
+        long dims = x->core.series_vector_size;
+        long m = x->core.pattern_length;
+        double r = x->core.similarity;
+        long mode = x->mode;
+        long scales = x->scales;
+        long version = x->core.version;
+        double result[3 * SC_UTIL_APEN_MAX_SCALES];
+        double ci[2 * SC_UTIL_APEN_MAX_SCALES];
+        t_sc_util_apen_sampling sampling = {x->core.estimate_samples, x->core.estimate_seed, ci};
+        
+        //nothing changed since the last calculation, output it again without a snapshot
+        if(length >= m * 2 && sc_util_apen_core_cached(&x->core, mode, scales, result)) {
+            x->stat_last_time = 0.0;
+            x->stat_calculations++;
+            sysmem_copyptr(x->core.ci, ci, sizeof(double) * 2 * scales);
+            critical_exit(x->lock);
+            
+            sc_util_apen_worker_publish(x, mode, scales, (sampling.samples > 0), result, ci);
+            continue;
+        }
+        
+        if(!snapshot) {
+            //no memory for a snapshot, calculate on the series itself as without async, input waits for it
+            double start = systimer_gettime();
+            long ok = sc_util_apen_core_calculate(&x->core, mode, scales, result);
+            x->stat_last_time = systimer_gettime() - start;
+            x->stat_total_time += x->stat_last_time;
+            x->stat_calculations++;
+            sysmem_copyptr(x->core.ci, ci, sizeof(double) * 2 * scales);
+            critical_exit(x->lock);
+            
+            if(ok) {
+                sc_util_apen_worker_publish(x, mode, scales, (sampling.samples > 0), result, ci);
             }
-            m1[i] /= x->series_length - (x->pattern_length + 1) + 1;
-            avg_ratio1 += m1[i];
+            continue;
         }
         
-        //Ci(m+1)
-        avg_ratio1 /= x->series_length - (x->pattern_length + 1) + 1;
+        //each dimension is packed right after the previous one in the snapshot
+        sc_util_apen_core_copy(&x->core, x->worker_series);
+        critical_exit(x->lock);
         
-        //STEP 3: get the Approximate Entropy as the Natural Logarithm of (Ci(m) / Ci(m)+1)
-        double apen = log(avg_ratio0 / ((avg_ratio1 > 0.0) ? avg_ratio1 : 0.0000001)); //included a way to avoid division by 0 errors
+        if(length < m * 2) {
+            continue;
+        }
+        
+        t_sc_util_apen_stats stats = {0, 0, 0};
+        double start = systimer_gettime();
+        sc_util_apen_estimate(x->worker_series, length, dims, length, m, r, mode, x->worker_count0, x->worker_count1, 0, result, x->worker_work, &stats, &sampling);
+        if(scales > 1) {
+            //the counts of scale 1 are no longer needed, the coarser scales reuse them
+            sc_util_apen_multiscale(x->worker_series, length, dims, length, m, r, mode, scales, x->worker_scale_buffer, x->worker_count0, x->worker_count1, result, x->worker_work, &stats, &sampling);
+        }
+        double elapsed = systimer_gettime() - start;
+        
+        critical_enter(x->lock);
+        x->stat_last_time = elapsed;
+        x->stat_total_time += elapsed;
+        x->stat_calculations++;
+        x->core.stats.comparisons += stats.comparisons;
+        x->core.stats.rejections += stats.rejections;
+        sc_util_apen_core_store(&x->core, version, mode, scales, result, ci);
+        critical_exit(x->lock);
         
-        //outlet the value to the user
-        outlet_float(x->out2, apen);
+        sc_util_apen_worker_publish(x, mode, scales, (sampling.samples > 0), result, ci);
     }
+    
+    systhread_exit(0);
+    return NULL;
 }
 
-//function for calculating the maximum pair-wise distance of members between two vectors
-/* The function only compares members at matching indeces.
- Example:
- 
- Vec1:          Vec2:           Dist:
- 1     ->       5        =      4
- 2     ->       4        =      2
- 3     ->       3        =      0
- 4     ->       2        =      2
- 5     ->       1        =      4
- 
- Maximum Distance : 4
- 
+//grows the worker's snapshot buffers to the series, called by the worker with lock held
+/* If any of them cannot be allocated all of them are freed, so the worker never writes to a partial set,
+ and the next request tries again.
  */
+long sc_util_apen_worker_alloc(t_sc_util_apen *x) {
+    if(x->worker_capacity >= x->core.series_max_length && x->worker_dims >= x->core.series_vector_size) {
+        return 1;
+    }
+    if(x->worker_capacity) {
+        sysmem_freeptr(x->worker_series);
+        sysmem_freeptr(x->worker_count0);
+        sysmem_freeptr(x->worker_count1);
+        sysmem_freeptr(x->worker_scale_buffer);
+        sysmem_freeptr(x->worker_work);
+    }
+    long capacity = x->core.series_max_length;
+    long dims = x->core.series_vector_size;
+    x->worker_series = (double*)sysmem_newptr(sizeof(double) * capacity * dims);
+    x->worker_count0 = (long*)sysmem_newptr(sizeof(long) * capacity);
+    x->worker_count1 = (long*)sysmem_newptr(sizeof(long) * capacity);
+    x->worker_scale_buffer = (double*)sysmem_newptr(sizeof(double) * (2 * capacity + 2) * dims);
+    x->worker_work = sysmem_newptr(sc_util_apen_work_size(capacity, dims));
+    if(x->worker_series && x->worker_count0 && x->worker_count1 && x->worker_scale_buffer && x->worker_work) {
+        x->worker_capacity = capacity;
+        x->worker_dims = dims;
+        return 1;
+    }
+    
+    if(x->worker_series) {
+        sysmem_freeptr(x->worker_series);
+    }
+    if(x->worker_count0) {
+        sysmem_freeptr(x->worker_count0);
+    }
+    if(x->worker_count1) {
+        sysmem_freeptr(x->worker_count1);
+    }
+    if(x->worker_scale_buffer) {
+        sysmem_freeptr(x->worker_scale_buffer);
+    }
+    if(x->worker_work) {
+        sysmem_freeptr(x->worker_work);
+    }
+    x->worker_series = NULL;
+    x->worker_count0 = NULL;
+    x->worker_count1 = NULL;
+    x->worker_scale_buffer = NULL;
+    x->worker_work = NULL;
+    x->worker_capacity = 0;
+    x->worker_dims = 0;
+    object_error((t_object *)x, "could not allocate the async copy of a series of length %ld, calculating on the series itself", capacity);
+    return 0;
+}
 
-/* Paramters
- d0 - Double pointer to vector 0
- d1 - Double pointer to vector 1
- l - long size of both vectors, vectors should be the same length
- r - similarity index. used for optimizing when a distance is greater than the similarity index.
+//makes a snapshot core for every channel with the size of the channel, called by the worker with lock held
+/* The cores are kept between batches and only remade when the channels or their sizes change.
+ If any of them cannot be made all of them are freed and the batch runs on the channels themselves.
  */
-double sc_util_apen_maxdist(double* d0, double* d1, long l, double r) {
-    double md = 0.0;
-    
-    double* t = d0;
-    double* t1 = d1;
-    for(int i = 0; i < (l - 1); i++, t++, t1++) {
-        double* t2 = t;
-        t2++;
-        for(int j = 1; j < (l - i); j++, t2++){
-           md = (fabs(*t2 - *t) > md) ? md = fabs(*t2 - *t) : md;
-            if(md > r) { //if the distance exceeds the similarity index r, just return the value, no need to calculate further
-                return md;
-            }
+long sc_util_apen_worker_cores_alloc(t_sc_util_apen *x) {
+    long channels = x->channels;
+    
+    if(x->worker_core_count != channels) {
+        sc_util_apen_worker_cores_free(x);
+        x->worker_cores = (t_sc_util_apen_core*)sysmem_newptrclear(sizeof(t_sc_util_apen_core) * channels);
+        x->worker_channel_result = (double*)sysmem_newptr(sizeof(double) * SC_UTIL_APEN_CHANNEL_RESULT * channels);
+        if(!x->worker_cores || !x->worker_channel_result) {
+            sc_util_apen_worker_cores_free(x);
+            object_error((t_object *)x, "could not allocate the async copy of %ld channels, calculating on the channels themselves", channels);
+            return 0;
+        }
+        x->worker_core_count = channels;
+    }
+    
+    for(long c = 0; c < channels; c++) {
+        t_sc_util_apen_core* core = sc_util_apen_channel(x, c);
+        t_sc_util_apen_core* snapshot = x->worker_cores + c;
+        if(snapshot->test_value && snapshot->series_max_length == core->series_max_length && snapshot->series_vector_size == core->series_vector_size) {
+            continue;
+        }
+        if(snapshot->test_value) {
+            sc_util_apen_core_free(snapshot);
+        }
+        if(!sc_util_apen_core_init(snapshot, core->series_max_length, core->series_vector_size)) {
+            sc_util_apen_worker_cores_free(x);
+            object_error((t_object *)x, "could not allocate the async copy of %ld channels, calculating on the channels themselves", channels);
+            return 0;
+        }
+    }
+    return 1;
+}
+
+void sc_util_apen_worker_cores_free(t_sc_util_apen *x) {
+    if(x->worker_cores) {
+        for(long c = 0; c < x->worker_core_count; c++) {
+            sc_util_apen_core_free(x->worker_cores + c);
         }
+        sysmem_freeptr(x->worker_cores);
+    }
+    if(x->worker_channel_result) {
+        sysmem_freeptr(x->worker_channel_result);
     }
+    x->worker_cores = NULL;
+    x->worker_channel_result = NULL;
+    x->worker_core_count = 0;
+}
+
+//calculates a batch of channels on the pool and hands it to sc_util_apen_worker_output
+/* Every channel is copied into its snapshot under the lock and the batch runs after leaving it,
+ so input to any channel only waits for the copies. The results are kept by the channels that did not change meanwhile.
+ Without memory for the snapshots the channels are calculated in place as without async, and input waits for the batch.
+ */
+void sc_util_apen_worker_channels(t_sc_util_apen *x) {
+    long mode = x->mode;
+    long scales = x->scales;
+    long channels = x->channels;
+    double* result = NULL;
+    double start = systimer_gettime();
     
-    return md;
+    if(!sc_util_apen_worker_cores_alloc(x)) {
+        sc_util_apen_batch(x, NULL, channels, x->channel_result, mode, scales);
+        result = x->channel_result;
+    } else {
+        result = x->worker_channel_result;
+        for(long c = 0; c < channels; c++) {
+            sc_util_apen_core_snapshot(sc_util_apen_channel(x, c), x->worker_cores + c);
+        }
+        critical_exit(x->lock);
+        
+        sc_util_apen_batch(x, x->worker_cores, channels, result, mode, scales);
+        
+        critical_enter(x->lock);
+        //set_channels may have replaced the channels while the lock was left
+        if(x->channels != channels) {
+            critical_exit(x->lock);
+            return;
+        }
+        for(long c = 0; c < channels; c++) {
+            t_sc_util_apen_core* core = sc_util_apen_channel(x, c);
+            t_sc_util_apen_core* snapshot = x->worker_cores + c;
+            core->stats.comparisons += snapshot->stats.comparisons;
+            core->stats.rejections += snapshot->stats.rejections;
+            core->stats.cached += snapshot->stats.cached;
+            sc_util_apen_core_store(core, snapshot->version, mode, scales, result + c * SC_UTIL_APEN_CHANNEL_RESULT, snapshot->ci);
+        }
+    }
+    x->stat_last_time = systimer_gettime() - start;
+    x->stat_total_time += x->stat_last_time;
+    x->stat_calculations++;
+    
+    //channel_output is sized with the channels, which cannot change while lock is held
+    systhread_mutex_lock(x->worker_mutex);
+    sysmem_copyptr(result, x->channel_output, sizeof(double) * SC_UTIL_APEN_CHANNEL_RESULT * channels);
+    x->worker_mode = mode;
+    x->worker_scales = scales;
+    x->worker_channels = channels;
+    systhread_mutex_unlock(x->worker_mutex);
+    critical_exit(x->lock);
+    
+    qelem_set(x->worker_qelem);
+}
+
+void sc_util_apen_worker_publish(t_sc_util_apen *x, long mode, long scales, long estimate, double* result, double* ci) {
+    systhread_mutex_lock(x->worker_mutex);
+    for(int i = 0; i < 3 * scales; i++) {
+        x->worker_result[i] = result[i];
+    }
+    for(int i = 0; i < 2 * scales; i++) {
+        x->worker_ci[i] = ci[i];
+    }
+    x->worker_mode = mode;
+    x->worker_scales = scales;
+    x->worker_estimate = estimate;
+    x->worker_channels = 0;
+    systhread_mutex_unlock(x->worker_mutex);
+    
+    qelem_set(x->worker_qelem);
+}
+
+void sc_util_apen_worker_output(t_sc_util_apen *x) {
+    double result[3 * SC_UTIL_APEN_MAX_SCALES];
+    double ci[2 * SC_UTIL_APEN_MAX_SCALES];
+    
+    //a batch of channels is output from channel_output, copied into channel_atoms before either lock is left
+    critical_enter(x->lock);
+    systhread_mutex_lock(x->worker_mutex);
+    long channels = x->worker_channels;
+    if(channels > 1 && channels <= x->channels) {
+        long n = 0;
+        t_atom* list = sc_util_apen_channel_list(x, channels, x->worker_mode, x->worker_scales, x->channel_output, &n);
+        systhread_mutex_unlock(x->worker_mutex);
+        critical_exit(x->lock);
+        
+        outlet_list(x->out2, 0L, n, list);
+        return;
+    }
+    systhread_mutex_unlock(x->worker_mutex);
+    critical_exit(x->lock);
+    
+    systhread_mutex_lock(x->worker_mutex);
+    long mode = x->worker_mode;
+    long scales = x->worker_scales;
+    long estimate = x->worker_estimate;
+    for(int i = 0; i < 3 * scales; i++) {
+        result[i] = x->worker_result[i];
+    }
+    for(int i = 0; i < 2 * scales; i++) {
+        ci[i] = x->worker_ci[i];
+    }
+    systhread_mutex_unlock(x->worker_mutex);
+    
+    if(estimate && mode != SC_UTIL_APEN_MODE_FUZZYEN) {
+        sc_util_apen_output_confidence(x, scales, ci);
+    }
+    sc_util_apen_output(x, mode, scales, result);
+}
+
+void sc_util_apen_worker_stop(t_sc_util_apen *x) {
+    if(x->worker) {
+        unsigned int ret;
+        
+        systhread_mutex_lock(x->worker_mutex);
+        x->worker_quit = 1;
+        systhread_cond_signal(x->worker_cond);
+        systhread_mutex_unlock(x->worker_mutex);
+        
+        systhread_join(x->worker, &ret);
+        x->worker = NULL;
+    }
+    
+    if(x->worker_qelem) {
+        qelem_free(x->worker_qelem);
+        x->worker_qelem = NULL;
+    }
+    if(x->worker_mutex) {
+        systhread_mutex_free(x->worker_mutex);
+        x->worker_mutex = NULL;
+    }
+    if(x->worker_cond) {
+        systhread_cond_free(x->worker_cond);
+        x->worker_cond = NULL;
+    }
+    
+    if(x->worker_capacity) {
+        sysmem_freeptr(x->worker_series);
+        sysmem_freeptr(x->worker_count0);
+        sysmem_freeptr(x->worker_count1);
+        sysmem_freeptr(x->worker_scale_buffer);
+        sysmem_freeptr(x->worker_work);
+    }
+    x->worker_series = NULL;
+    x->worker_count0 = NULL;
+    x->worker_count1 = NULL;
+    x->worker_scale_buffer = NULL;
+    x->worker_work = NULL;
+    x->worker_capacity = 0;
+    x->worker_dims = 0;
+    sc_util_apen_worker_cores_free(x);
 }
@@ -0,0 +1,752 @@
+/**
+	@file
+	sc.util.apen.core - series storage and entropy calculation behind sc.apen, plain C without the Max SDK
+	Connor Rawls - cwrawls@asu.edu
+
+    Copyright Synthesis Center, Arizona State University, 2018
+
+	@ingroup    analysis-utilities
+*/
+
+#include <string.h>
+
+#include "sc.util.apen.core.h"
+
+long sc_util_apen_core_init(t_sc_util_apen_core *c, long max_length, long dims) {
+    c->series_length = 0;
+    c->series_max_length = max_length;
+    c->series_vector_size = dims;
+    c->similarity = 1.0;
+    c->similarity_factor = 1.0;
+    c->similarity_mode = SC_UTIL_APEN_SIMILARITY_ABSOLUTE;
+    c->running_mean = 0.0;
+    c->running_m2 = 0.0;
+    c->running_count = 0;
+    c->pattern_length = 3;
+    c->match = sc_util_apen_match_for(c->pattern_length);
+    c->match_block = sc_util_apen_match_block_for(c->pattern_length);
+    c->incremental = 1;
+    c->series_head = 0;
+    c->count_head = 0;
+    c->counts_valid = c->incremental; //series starts empty
+    c->version = 0;
+    c->result_version = -1;
+    c->result_mode = SC_UTIL_APEN_MODE_APEN;
+    c->result_scales = 0;
+    c->estimate_samples = 0;
+    c->estimate_seed = 1;
+    c->scale_buffer = NULL;
+    c->scale_count = NULL;
+    c->scale_capacity = 0;
+    c->scale_count_capacity = 0;
+    c->work = NULL;
+    c->stats.comparisons = 0;
+    c->stats.rejections = 0;
+    c->stats.cached = 0;
+    
+    //one mirrored ring per dimension, the counts slide through twice the room they need
+    c->test_value = (double*)calloc(max_length * 2 * dims, sizeof(double));
+    c->match_count0 = (long*)malloc(sizeof(long) * max_length * 2);
+    c->match_count1 = (long*)malloc(sizeof(long) * max_length * 2);
+    c->work = malloc(sc_util_apen_work_size(max_length, dims));
+    if(!c->test_value || !c->match_count0 || !c->match_count1 || !c->work) {
+        sc_util_apen_core_free(c);
+        return 0;
+    }
+    return 1;
+}
+
+void sc_util_apen_core_free(t_sc_util_apen_core *c) {
+    //the series and count arrays are each a single allocation
+    free(c->test_value);
+    free(c->match_count0);
+    free(c->match_count1);
+    free(c->work);
+    c->test_value = NULL;
+    c->match_count0 = NULL;
+    c->match_count1 = NULL;
+    c->work = NULL;
+    free(c->scale_buffer);
+    free(c->scale_count);
+    c->scale_buffer = NULL;
+    c->scale_count = NULL;
+    c->scale_capacity = 0;
+    c->scale_count_capacity = 0;
+}
+
+void sc_util_apen_core_clear(t_sc_util_apen_core *c) {
+    double* temp = c->test_value;
+    
+    for(int i = 0; i < c->series_length; i++, temp++) {
+        *temp = 0;
+    }
+    
+    c->series_length = 0;
+    c->series_head = 0;
+    c->count_head = 0;
+    c->running_mean = 0.0;
+    c->running_m2 = 0.0;
+    c->running_count = 0;
+    c->version++;
+    sc_util_apen_core_update_similarity(c);
+    
+    //an empty series has no templates, so the (empty) counts are trivially up to date
+    c->counts_valid = c->incremental;
+}
+
+long sc_util_apen_core_set_max_length(t_sc_util_apen_core *c, long max_length) {
+    double* temp = (double*)malloc(sizeof(double) * max_length * 2 * c->series_vector_size);
+    long* count0 = (long*)malloc(sizeof(long) * max_length * 2);
+    long* count1 = (long*)malloc(sizeof(long) * max_length * 2);
+    void* work = malloc(sc_util_apen_work_size(max_length, c->series_vector_size));
+    if(!temp || !count0 || !count1 || !work) {
+        free(temp);
+        free(count0);
+        free(count1);
+        free(work);
+        return 0;
+    }
+    
+    //keep the most recent values, oldest first at the start of the new ring
+    long keep = (c->series_length > max_length) ? max_length : c->series_length;
+    for(int k = 0; k < c->series_vector_size; k++) {
+        double* d = c->test_value + k * 2 * c->series_max_length + c->series_head + (c->series_length - keep);
+        double* plane = temp + k * 2 * max_length;
+        memcpy(plane, d, sizeof(double) * keep);
+        memcpy(plane + max_length, d, sizeof(double) * keep);
+    }
+    
+    //clear old data
+    free(c->test_value);
+    c->test_value = temp;
+    c->series_head = 0;
+    c->series_length = keep;
+    
+    //match counts are rebuilt on the next calculation
+    free(c->match_count0);
+    free(c->match_count1);
+    c->match_count0 = count0;
+    c->match_count1 = count1;
+    c->count_head = 0;
+    free(c->work);
+    c->work = work;
+    c->counts_valid = 0;
+    c->version++;
+    
+    c->series_max_length = max_length;
+    if(c->similarity_mode == SC_UTIL_APEN_SIMILARITY_RELATIVE) {
+        sc_util_apen_core_restat(c);
+    }
+    return 1;
+}
+
+long sc_util_apen_core_set_vector_size(t_sc_util_apen_core *c, long dims) {
+    if(dims == c->series_vector_size) {
+        return 1;
+    }
+    
+    //the stored vectors no longer have the right size, start a new series
+    double* temp = (double*)calloc(c->series_max_length * 2 * dims, sizeof(double));
+    void* work = malloc(sc_util_apen_work_size(c->series_max_length, dims));
+    if(!temp || !work) {
+        free(temp);
+        free(work);
+        return 0;
+    }
+    free(c->test_value);
+    free(c->work);
+    c->test_value = temp;
+    c->work = work;
+    c->series_vector_size = dims;
+    sc_util_apen_core_clear(c);
+    return 1;
+}
+
+void sc_util_apen_core_set_pattern_length(t_sc_util_apen_core *c, long m) {
+    if(m != c->pattern_length) {
+        //a shorter pattern has more windows, which must start from the beginning of the count arrays
+        c->counts_valid = 0;
+        c->count_head = 0;
+        c->version++;
+    }
+    c->pattern_length = m;
+    c->match = sc_util_apen_match_for(m);
+    c->match_block = sc_util_apen_match_block_for(m);
+}
+
+void sc_util_apen_core_set_similarity(t_sc_util_apen_core *c, double r) {
+    c->similarity_factor = r;
+    sc_util_apen_core_update_similarity(c);
+}
+
+void sc_util_apen_core_set_similarity_mode(t_sc_util_apen_core *c, long mode) {
+    c->similarity_mode = mode;
+    //the running statistics are only kept in relative mode, start them from the series as it is
+    if(mode == SC_UTIL_APEN_SIMILARITY_RELATIVE) {
+        sc_util_apen_core_restat(c);
+    } else {
+        sc_util_apen_core_update_similarity(c);
+    }
+}
+
+//sets the r used by calculations, similarity_factor itself or similarity_factor times the standard deviation of the series
+/* The match counts depend on r, so they are only kept when r does not change. In relative mode almost every new value
+ moves the standard deviation, and the counts are then recounted by the next calculation instead of following the input.
+ */
+void sc_util_apen_core_update_similarity(t_sc_util_apen_core *c) {
+    double r = c->similarity_factor;
+    if(c->similarity_mode == SC_UTIL_APEN_SIMILARITY_RELATIVE) {
+        r *= (c->running_count > 0) ? sqrt(c->running_m2 / c->running_count) : 0.0;
+    }
+    if(r != c->similarity) {
+        c->counts_valid = 0;
+        c->count_head = 0;
+        c->version++;
+    }
+    c->similarity = r;
+}
+
+//recomputes the running mean and variance from the values in the series
+/* Used when the series changes all at once, and once every series_max_length values to drop the rounding
+ the updates of sc_util_apen_core_add_value collect, so this stays O(1) per value on average.
+ */
+void sc_util_apen_core_restat(t_sc_util_apen_core *c) {
+    double mean = 0.0;
+    double m2 = 0.0;
+    long n = c->series_length * c->series_vector_size;
+    
+    for(int k = 0; k < c->series_vector_size; k++) {
+        double* d = c->test_value + k * 2 * c->series_max_length + c->series_head;
+        for(int t = 0; t < c->series_length; t++) {
+            mean += d[t];
+        }
+    }
+    mean = n ? mean / n : 0.0;
+    for(int k = 0; k < c->series_vector_size; k++) {
+        double* d = c->test_value + k * 2 * c->series_max_length + c->series_head;
+        for(int t = 0; t < c->series_length; t++) {
+            m2 += (d[t] - mean) * (d[t] - mean);
+        }
+    }
+    
+    c->running_mean = mean;
+    c->running_m2 = m2;
+    c->running_count = n;
+    sc_util_apen_core_update_similarity(c);
+}
+
+//Welford's update of the running mean and variance, run backwards for a value leaving the series
+void sc_util_apen_core_add_value(t_sc_util_apen_core *c, double v, long delta) {
+    if(delta > 0) {
+        c->running_count++;
+        double d = v - c->running_mean;
+        c->running_mean += d / c->running_count;
+        c->running_m2 += d * (v - c->running_mean);
+    } else if(c->running_count <= 1) {
+        c->running_count = 0;
+        c->running_mean = 0.0;
+        c->running_m2 = 0.0;
+    } else {
+        c->running_count--;
+        double d = v - c->running_mean;
+        c->running_mean -= d / c->running_count;
+        c->running_m2 -= d * (v - c->running_mean);
+        if(c->running_m2 < 0.0) {
+            c->running_m2 = 0.0;
+        }
+    }
+}
+
+void sc_util_apen_core_set_incremental(t_sc_util_apen_core *c, long incremental) {
+    c->incremental = incremental;
+    //turning the mode on needs a full count before updates can begin, so the next calculation cannot be answered from the cache
+    sc_util_apen_core_changed(c);
+}
+
+//adds a single vector to the end of the series, dropping the oldest vector once the series is full
+/* test_value is a ring buffer of series_max_length values stored twice, back to back.
+ Every value is written to both halves, so the series can always be read as one contiguous
+ block starting at series_head no matter where the ring wraps, and adding a value never moves the others.
+ 
+ Vectors are stored one dimension after the other (structure of arrays): dimension k of the series
+ is its own mirrored ring starting at test_value + k * 2 * series_max_length, so the comparison kernels
+ read every dimension with the same contiguous loads as a 1-D series.
+ 
+ The match counts are kept as a sliding block inside an array of twice the needed size,
+ the oldest count is dropped by moving count_head forward and the block is moved back to the start
+ of the array only when it runs out of room, once every series_max_length values.
+ */
+void sc_util_apen_core_append(t_sc_util_apen_core *c, double* d) {
+    long m = c->pattern_length;
+    long max = c->series_max_length;
+    long pos = 0;
+    long relative = (c->similarity_mode == SC_UTIL_APEN_SIMILARITY_RELATIVE);
+    
+    c->version++;
+    if(!c->incremental || c->estimate_samples > 0) {
+        //counts left by the last calculation, not kept up to date while calculations sample instead of using them
+        c->counts_valid = 0;
+        c->count_head = 0;
+    }
+    if(relative) {
+        //move r before the counts are touched, so they are only updated if r stays the same
+        if(c->series_length == max) {
+            double* old = c->test_value + c->series_head;
+            for(int k = 0; k < c->series_vector_size; k++, old += 2 * max) {
+                sc_util_apen_core_add_value(c, *old, -1);
+            }
+        }
+        for(int k = 0; k < c->series_vector_size; k++) {
+            sc_util_apen_core_add_value(c, d[k], 1);
+        }
+        sc_util_apen_core_update_similarity(c);
+    }
+    
+    if(c->series_length < max) {
+        pos = c->series_head + c->series_length;
+        if(pos >= max) {
+            pos -= max;
+        }
+        c->series_length++;
+    } else {
+        if(c->counts_valid) {
+            //take the oldest templates out of every other template's count before they are lost
+            sc_util_apen_update_counts(c, 0, 0, -1);
+            c->count_head++;
+        }
+        
+        pos = c->series_head;
+        c->series_head = (c->series_head + 1 < max) ? c->series_head + 1 : 0;
+    }
+    
+    double* plane = c->test_value;
+    for(int k = 0; k < c->series_vector_size; k++, plane += 2 * max) {
+        plane[pos] = d[k];
+        plane[pos + max] = d[k];
+    }
+    
+    if(relative && c->series_head == 0 && c->series_length == max) {
+        //once per trip around the ring
+        sc_util_apen_core_restat(c);
+    }
+    
+    if(c->counts_valid) {
+        long n0 = c->series_length - m + 1;
+        
+        if(n0 > 0 && c->count_head + n0 > 2 * max) {
+            memmove(c->match_count0, c->match_count0 + c->count_head, sizeof(long) * (n0 - 1));
+            memmove(c->match_count1, c->match_count1 + c->count_head, sizeof(long) * (n0 - 1));
+            c->count_head = 0;
+        }
+        
+        //the newest templates of each size end on the value that was just added
+        sc_util_apen_update_counts(c, n0 - 1, n0 - 2, 1);
+    }
+}
+
+//adds count vectors of series_vector_size values, stored one vector after the other
+void sc_util_apen_core_append_list(t_sc_util_apen_core *c, double* d, long count) {
+    if(count * 2 > c->series_max_length) {
+        //long lists replace most of the series, recount from scratch on the next calculation
+        c->counts_valid = 0;
+        c->count_head = 0;
+    }
+    
+    //short lists are cheaper to fold into the match counts one value at a time
+    for(int i = 0; i < count; i++) {
+        sc_util_apen_core_append(c, d + i * c->series_vector_size);
+    }
+}
+
+//calculates the values mode asks for at every scale, 3 per scale like sc_util_apen_estimate
+/* Uses the match counts kept on input when they are valid and leaves them valid afterwards when incremental is set.
+ A series with more windows than estimate_samples is always sampled, whatever counts there are, so the value only
+ depends on the series and the seed. The buffers for scales > 1 are allocated on first use and kept for later calculations.
+ */
+long sc_util_apen_core_calculate(t_sc_util_apen_core *c, long mode, long scales, double* result) {
+    for(int i = 0; i < 3 * scales; i++) {
+        result[i] = 0.0;
+    }
+    if(c->series_length < c->pattern_length * 2) {
+        return 0;
+    }
+    if(sc_util_apen_core_cached(c, mode, scales, result)) {
+        return 1;
+    }
+    
+    //count similar windows for pattern length and pattern length + 1 (unless the counts were kept up to date on input) and turn them into the estimators
+    long* c0 = c->match_count0 + c->count_head;
+    long* c1 = c->match_count1 + c->count_head;
+    t_sc_util_apen_sampling sampling = {c->estimate_samples, c->estimate_seed, c->ci};
+    //long series sample instead of counting, the counts are not kept meanwhile (see sc_util_apen_core_append)
+    long sampled = c->estimate_samples > 0 && c->estimate_samples < c->series_length - c->pattern_length;
+    sc_util_apen_estimate(c->test_value + c->series_head, c->series_length, c->series_vector_size, 2 * c->series_max_length, c->pattern_length, c->similarity, mode, c0, c1, c->counts_valid && !sampled, result, c->work, &c->stats, &sampling);
+    if(mode != SC_UTIL_APEN_MODE_FUZZYEN && !sampled) {
+        //without incremental the counts still serve another mode until the next input
+        c->counts_valid = 1;
+    } else if(mode != SC_UTIL_APEN_MODE_FUZZYEN) {
+        //only the sampled windows were counted
+        c->counts_valid = 0;
+        c->count_head = 0;
+    }
+    
+    //coarser scales share one buffer for the prefix sums and the coarse-grained series, kept between calculations
+    /* The buffer follows series_max_length * series_vector_size and the counts series_max_length alone,
+     so each has its own capacity: a longer series with fewer dimensions needs more counts in the same buffer.
+     */
+    if(scales > 1) {
+        long needed = (2 * c->series_max_length + 2) * c->series_vector_size;
+        long counts = c->series_max_length + 2;
+        if(c->scale_capacity < needed) {
+            free(c->scale_buffer);
+            c->scale_buffer = (double*)malloc(sizeof(double) * needed);
+            c->scale_capacity = c->scale_buffer ? needed : 0;
+        }
+        if(c->scale_count_capacity < counts) {
+            free(c->scale_count);
+            c->scale_count = (long*)malloc(sizeof(long) * counts);
+            c->scale_count_capacity = c->scale_count ? counts : 0;
+        }
+        if(!c->scale_buffer || !c->scale_count) {
+            for(int i = 0; i < 3 * scales; i++) {
+                result[i] = 0.0;
+            }
+            return 0;
+        }
+        sc_util_apen_multiscale(c->test_value + c->series_head, c->series_length, c->series_vector_size, 2 * c->series_max_length, c->pattern_length, c->similarity, mode, scales, c->scale_buffer, c->scale_count, c->scale_count + c->series_max_length / 2 + 1, result, c->work, &c->stats, &sampling);
+    }
+    sc_util_apen_core_store(c, c->version, mode, scales, result, NULL);
+    return 1;
+}
+
+//fills result with the values of the last calculation when the series and parameters are unchanged since
+/* Any input or change of pattern_length, similarity or series_length moves version on and so drops the result.
+ Only the same mode and scales are answered, another mode still reuses the match counts if they are valid.
+ */
+long sc_util_apen_core_cached(t_sc_util_apen_core *c, long mode, long scales, double* result) {
+    if(c->result_version != c->version || c->result_mode != mode || c->result_scales != scales) {
+        return 0;
+    }
+    memcpy(result, c->result, sizeof(double) * 3 * scales);
+    c->stats.cached++;
+    return 1;
+}
+
+//keeps result as the values of version, for a calculation made on a copy of the series outside of the core
+/* Nothing is kept if the series has changed since the copy was made. */
+void sc_util_apen_core_store(t_sc_util_apen_core *c, long version, long mode, long scales, double* result, double* ci) {
+    if(version != c->version) {
+        return;
+    }
+    memcpy(c->result, result, sizeof(double) * 3 * scales);
+    if(ci) {
+        memcpy(c->ci, ci, sizeof(double) * 2 * scales);
+    }
+    c->result_version = version;
+    c->result_mode = mode;
+    c->result_scales = scales;
+}
+
+//sets how many reference windows a calculation samples, see sc_util_apen_sampled
+/* A different sample gives a different result, so changing either value drops the cached one.
+ Incremental counts are suspended while samples > 0, a change of samples drops them so they are recounted when it goes back to 0.
+ */
+void sc_util_apen_core_set_estimate(t_sc_util_apen_core *c, long samples, unsigned long seed) {
+    if(samples != c->estimate_samples) {
+        sc_util_apen_core_changed(c);
+    } else if(seed != c->estimate_seed) {
+        c->version++;
+    }
+    c->estimate_samples = samples;
+    c->estimate_seed = seed;
+}
+
+void sc_util_apen_core_changed(t_sc_util_apen_core *c) {
+    c->version++;
+    c->counts_valid = 0;
+    c->count_head = 0;
+}
+
+//copies the series into out, series_length values of the first dimension followed by the next dimension and so on
+void sc_util_apen_core_copy(t_sc_util_apen_core *c, double* out) {
+    for(int k = 0; k < c->series_vector_size; k++) {
+        memcpy(out + k * c->series_length, c->test_value + k * 2 * c->series_max_length + c->series_head, sizeof(double) * c->series_length);
+    }
+}
+
+//makes out a copy of the series, its parameters, match counts and cached result, to be calculated without c
+/* out was made with the series_max_length and series_vector_size of c and keeps its own buffers.
+ Only the values in the series and the counts of its windows are copied, out is never appended to.
+ Its stats start at 0 so that the caller can add them to those of c afterwards.
+ */
+void sc_util_apen_core_snapshot(t_sc_util_apen_core *c, t_sc_util_apen_core *out) {
+    double* test_value = out->test_value;
+    long* match_count0 = out->match_count0;
+    long* match_count1 = out->match_count1;
+    double* scale_buffer = out->scale_buffer;
+    long* scale_count = out->scale_count;
+    long scale_capacity = out->scale_capacity;
+    long scale_count_capacity = out->scale_count_capacity;
+    void* work = out->work;
+    
+    *out = *c;
+    out->test_value = test_value;
+    out->match_count0 = match_count0;
+    out->match_count1 = match_count1;
+    out->scale_buffer = scale_buffer;
+    out->scale_count = scale_count;
+    out->scale_capacity = scale_capacity;
+    out->scale_count_capacity = scale_count_capacity;
+    out->work = work;
+    out->incremental = 0;
+    out->stats.comparisons = 0;
+    out->stats.rejections = 0;
+    out->stats.cached = 0;
+    
+    for(int k = 0; k < c->series_vector_size; k++) {
+        long plane = k * 2 * c->series_max_length + c->series_head;
+        memcpy(out->test_value + plane, c->test_value + plane, sizeof(double) * c->series_length);
+    }
+    //one count per window of size pattern_length
+    long n0 = c->series_length - c->pattern_length + 1;
+    if(c->counts_valid && n0 > 0) {
+        memcpy(out->match_count0 + c->count_head, c->match_count0 + c->count_head, sizeof(long) * n0);
+        memcpy(out->match_count1 + c->count_head, c->match_count1 + c->count_head, sizeof(long) * n0);
+    }
+}
+
+//adds (delta = 1) or removes (delta = -1) the window of size m starting at t0 and the window of size m + 1 starting at t1
+/* Only the windows similar to the one being added or removed change, so this costs a single pass over the series
+ instead of the full pass over every pair of windows done by sc_util_apen_count_all.
+ When t0 and t1 start at the same place (removing the oldest windows) both sizes are decided in the same pass.
+ A window being added has its own count started at 0 here; a window being removed is left for the caller to drop.
+ Indices outside of the current set of windows are ignored.
+ */
+void sc_util_apen_update_counts(t_sc_util_apen_core *c, long t0, long t1, long delta) {
+    long n0 = c->series_length - c->pattern_length + 1;
+    long n1 = c->series_length - c->pattern_length;
+    
+    long has0 = (t0 >= 0 && t0 < n0);
+    long has1 = (t1 >= 0 && t1 < n1);
+    
+    if(has0 && has1 && t0 == t1) {
+        sc_util_apen_update_template(c, t0, 1, 1, delta);
+        return;
+    }
+    if(has0) {
+        sc_util_apen_update_template(c, t0, 1, 0, delta);
+    }
+    if(has1) {
+        sc_util_apen_update_template(c, t1, 0, 1, delta);
+    }
+}
+
+//compares the window starting at t against every window in the series
+/* use0 applies delta to the counts of windows similar at pattern_length,
+ use1 to the counts of windows similar at pattern_length + 1 (t must then have a window of that size).
+ */
+void sc_util_apen_update_template(t_sc_util_apen_core *c, long t, long use0, long use1, long delta) {
+    long n0 = c->series_length - c->pattern_length + 1;
+    long n1 = c->series_length - c->pattern_length;
+    long* c0 = c->match_count0 + c->count_head;
+    long* c1 = c->match_count1 + c->count_head;
+    double* series = c->test_value + c->series_head;
+    double* temp = series + t;
+    double* temp2 = series;
+    long stride = 2 * c->series_max_length;
+    long n = use0 ? n0 : n1;
+    long matched = 0; //windows similar at the size being tested, the window itself included
+    int j = 0;
+    
+    if(delta > 0) {
+        if(use0) {
+            c0[t] = 0;
+        }
+        if(use1) {
+            c1[t] = 0;
+        }
+    }
+    
+    for(; j + SC_UTIL_APEN_BLOCK <= n1; j += SC_UTIL_APEN_BLOCK, temp2 += SC_UTIL_APEN_BLOCK) {
+        long mask1 = 0;
+        long mask0 = c->match_block(temp, temp2, c->pattern_length, c->series_vector_size, stride, c->similarity, &mask1);
+        if(!use0) {
+            mask0 = mask1;
+            mask1 = 0;
+        } else if(!use1) {
+            mask1 = 0;
+        }
+        for(int b = 0; mask0 && b < SC_UTIL_APEN_BLOCK; b++) {
+            if(mask0 & (1 << b)) {
+                long* c = use0 ? c0 : c1;
+                matched++;
+                c[j + b] += delta;
+                if(j + b != t) {
+                    c[t] += delta;
+                }
+            }
+            if(mask1 & (1 << b)) {
+                c1[j + b] += delta;
+                if(j + b != t) {
+                    c1[t] += delta;
+                }
+            }
+        }
+    }
+    
+    for(; j < n; j++, temp2++) {
+        long match = c->match(temp, temp2, c->pattern_length, c->series_vector_size, stride, (use1 && j < n1), c->similarity);
+        if(use0 && match > 0) {
+            c0[j] += delta;
+            if(j != t) {
+                c0[t] += delta;
+            }
+        }
+        if(use1 && match > 1) {
+            c1[j] += delta;
+            if(j != t) {
+                c1[t] += delta;
+            }
+        }
+        if(match > (use0 ? 0 : 1)) {
+            matched++;
+        }
+    }
+    
+    c->stats.comparisons += n - 1;
+    c->stats.rejections += n - matched;
+}
+
+//fills result with ApEn, SampEn and FuzzyEn, only calculating the ones mode asks for
+/* ApEn and SampEn come from the same match counts, so asking for both costs one pass over the pairs of windows
+ plus O(N) work. The counts are only made if counts_ready is not set, otherwise c0 and c1 are used as they are.
+ FuzzyEn needs the distance of every pair and always has a pass of its own.
+ 
+ work is NULL or sc_util_apen_work_size(length, dims) bytes reused by the kernels instead of allocating.
+ If stats is not NULL the pairs of windows compared for the counts, and how many of them did not match
+ at pattern_length, are added to it. FuzzyEn has no similarity test and is not included.
+ 
+ If sampling is not NULL and asks for fewer windows than the series has, ApEn and SampEn are estimated from that many
+ sampled windows instead of counted (unless counts_ready), and c0 and c1 are left untouched. FuzzyEn is always exact.
+ sampling->ci then receives the confidence interval of ApEn, or ApEn itself at both ends when it was calculated exactly.
+ */
+void sc_util_apen_estimate(double* series, long length, long dims, long stride, long m, double r, long mode, long* c0, long* c1, long counts_ready, double* result, void* work, t_sc_util_apen_stats* stats, t_sc_util_apen_sampling* sampling) {
+    result[0] = 0.0;
+    result[1] = 0.0;
+    result[2] = 0.0;
+    
+    double ci[2] = {0.0, 0.0};
+    if(mode != SC_UTIL_APEN_MODE_FUZZYEN && !counts_ready && sampling && sampling->samples > 0 && sampling->samples < length - m) {
+        double pairs = 0;
+        double misses = 0;
+        sc_util_apen_sampled(series, length, dims, stride, m, r, sampling->samples, sampling->seed, result, ci, &pairs, &misses);
+        if(stats) {
+            stats->comparisons += pairs;
+            stats->rejections += misses;
+        }
+    } else if(mode != SC_UTIL_APEN_MODE_FUZZYEN) {
+        if(!counts_ready) {
+            double pairs = sc_util_apen_count_all(series, length, dims, stride, m, r, c0, c1, work);
+            if(stats) {
+                //every count holds the window itself and both directions of each matching pair
+                double matched = 0;
+                for(int i = 0; i < length - m + 1; i++) {
+                    matched += c0[i] - 1;
+                }
+                stats->comparisons += pairs;
+                //the hashed count compares each window with one other, fewer pairs than it finds matching
+                stats->rejections += (pairs > matched / 2) ? pairs - matched / 2 : 0;
+            }
+        }
+        if(mode != SC_UTIL_APEN_MODE_SAMPEN) {
+            result[0] = sc_util_apen_from_counts(length, m, c0, c1);
+        }
+        if(mode != SC_UTIL_APEN_MODE_APEN) {
+            result[1] = sc_util_apen_sampen_from_counts(length, m, c0, c1);
+        }
+        ci[0] = result[0];
+        ci[1] = result[0];
+    }
+    if(sampling && sampling->ci) {
+        sampling->ci[0] = ci[0];
+        sampling->ci[1] = ci[1];
+    }
+    if(mode == SC_UTIL_APEN_MODE_FUZZYEN || mode == SC_UTIL_APEN_MODE_ALL) {
+        result[2] = sc_util_apen_fuzzyen(series, length, dims, stride, m, r, work);
+    }
+}
+
+//standard deviation of the series, every value of every dimension taken as one population
+double sc_util_apen_sd(double* series, long length, long dims, long stride) {
+    double mean = 0.0;
+    double var = 0.0;
+    
+    if(length < 1) {
+        return 0.0;
+    }
+    for(int k = 0; k < dims; k++) {
+        for(int t = 0; t < length; t++) {
+            mean += series[k * stride + t];
+        }
+    }
+    mean /= length * dims;
+    for(int k = 0; k < dims; k++) {
+        for(int t = 0; t < length; t++) {
+            double d = series[k * stride + t] - mean;
+            var += d * d;
+        }
+    }
+    return sqrt(var / (length * dims));
+}
+
+//multiscale entropy, fills result with the values of scales 2 ... scales, three per scale like sc_util_apen_estimate
+/* The coarse-grained series at scale s averages every s consecutive values. All scales are taken from one set of
+ running sums, so each coarse value is a single difference, and every scale reuses the same coarse-grained
+ series and counts. scratch holds (2 * length + 2) * dims values, c0 and c1 at least length / 2 values each.
+ Scales whose coarse-grained series is too short for pattern_length give 0.
+ Every scale is sampled as sampling asks, see sc_util_apen_estimate, with its confidence interval at sampling->ci + 2 * (scale - 1).
+ */
+void sc_util_apen_multiscale(double* series, long length, long dims, long stride, long m, double r, long mode, long scales, double* scratch, long* c0, long* c1, double* result, void* work, t_sc_util_apen_stats* stats, t_sc_util_apen_sampling* sampling) {
+    double* prefix = scratch;                       //running sums, length + 1 per dimension
+    double* coarse = scratch + (length + 1) * dims; //coarse-grained series, one dimension after another
+
+    for(int k = 0; k < dims; k++) {
+        double* d = series + k * stride;
+        double* p = prefix + k * (length + 1);
+        p[0] = 0.0;
+        for(int t = 0; t < length; t++) {
+            p[t + 1] = p[t] + d[t];
+        }
+    }
+
+    for(long s = 2; s <= scales; s++) {
+        long cl = length / s; //length of the coarse-grained series
+        double* res = result + 3 * (s - 1);
+        t_sc_util_apen_sampling scale_sampling;
+        if(sampling) {
+            scale_sampling = *sampling;
+            scale_sampling.ci = sampling->ci ? sampling->ci + 2 * (s - 1) : NULL;
+        }
+
+        if(cl < m * 2) {
+            res[0] = 0.0;
+            res[1] = 0.0;
+            res[2] = 0.0;
+            if(sampling && sampling->ci) {
+                scale_sampling.ci[0] = 0.0;
+                scale_sampling.ci[1] = 0.0;
+            }
+            continue;
+        }
+
+        for(int k = 0; k < dims; k++) {
+            double* p = prefix + k * (length + 1);
+            double* c = coarse + k * cl;
+            for(int t = 0; t < cl; t++) {
+                c[t] = (p[(t + 1) * s] - p[t * s]) / s;
+            }
+        }
+
+        sc_util_apen_estimate(coarse, cl, dims, cl, m, r, mode, c0, c1, 0, res, work, stats, sampling ? &scale_sampling : NULL);
+    }
+}
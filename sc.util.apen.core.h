@@ -0,0 +1,116 @@
+/**
+	@file
+	sc.util.apen.core - series storage and entropy calculation behind sc.apen, plain C without the Max SDK
+	Connor Rawls - cwrawls@asu.edu
+
+    Copyright Synthesis Center, Arizona State University, 2018
+
+	@ingroup    analysis-utilities
+*/
+
+#ifndef SC_UTIL_APEN_CORE_H
+#define SC_UTIL_APEN_CORE_H
+
+#include "sc.util.apen.kernel.h"           // template counting
+
+//values of the mode attribute
+#define SC_UTIL_APEN_MODE_APEN 0            // Approximate Entropy
+#define SC_UTIL_APEN_MODE_SAMPEN 1          // Sample Entropy
+#define SC_UTIL_APEN_MODE_FUZZYEN 2         // Fuzzy Entropy
+#define SC_UTIL_APEN_MODE_COMBINED 3        // ApEn and SampEn as a list, from the same match counts
+#define SC_UTIL_APEN_MODE_ALL 4             // ApEn, SampEn and FuzzyEn as a list
+
+#define SC_UTIL_APEN_MAX_SCALES 64          // largest value of the scales attribute
+
+//values of the similarity_mode attribute
+#define SC_UTIL_APEN_SIMILARITY_ABSOLUTE 0  // similarity is r itself
+#define SC_UTIL_APEN_SIMILARITY_RELATIVE 1  // similarity is k, r = k * standard deviation of the series
+
+////////////////////////// running totals of the work done by the similarity test, see sc_util_apen_estimate
+typedef struct _sc_util_apen_stats
+{
+    double                  comparisons;                //number of pairs of windows compared
+    double                  rejections;                 //number of those found not similar at pattern_length, the comparisons that could stop early
+    double                  cached;                     //number of calculations answered with the result of the previous one
+} t_sc_util_apen_stats;
+
+////////////////////////// sampled estimation, see sc_util_apen_sampled
+typedef struct _sc_util_apen_sampling
+{
+    long                    samples;                    //number of reference windows sampled, 0 to calculate every window
+    unsigned long           seed;                       //seed of the random choice of windows
+    double*                 ci;                         //receives the low and high end of the 95% confidence interval of ApEn, two values per scale, may be NULL
+} t_sc_util_apen_sampling;
+
+////////////////////////// series and match counts of one sc.apen
+/* Nothing here locks, the caller keeps every call on one core from overlapping
+ (sc.apen wraps them in a critical region of its own).
+ */
+typedef struct _sc_util_apen_core
+{
+    long                    series_length;              //the current size of the array. Must be >= 1 <= series_max_length
+    long                    series_max_length;          //the maximum size of the array
+    long                    series_vector_size;         //the size of the vector held at each point in the series
+    double                  similarity;                 //the thresholding factor when considering the similarity between patterns, the r every calculation uses
+    double                  similarity_factor;          //the value set for similarity, r itself or k in relative mode
+    long                    similarity_mode;            //one of SC_UTIL_APEN_SIMILARITY_*
+    double                  running_mean;               //mean of every value in the series, all dimensions together, see sc_util_apen_core_add_value
+    double                  running_m2;                 //sum of squared distances from running_mean
+    long                    running_count;              //number of values in running_mean, series_length * series_vector_size
+    long                    pattern_length;             //the number of points in the series considered in a single pattern
+    t_sc_util_apen_match    match;                      //pair comparison for pattern_length, see sc_util_apen_match_for
+    t_sc_util_apen_match_block match_block;             //block comparison for pattern_length, see sc_util_apen_match_block_for
+    long                    incremental;                //flag to determine if template match counts are kept up to date as data enters and leaves the series
+    long                    counts_valid;               //flag set while match_count0/match_count1 describe the current series, pattern_length and similarity
+    long                    version;                    //incremented whenever the series, pattern_length or similarity change, see sc_util_apen_core_cached
+    long                    result_version;             //version result was calculated for, -1 if there is none
+    long                    result_mode;                //mode result was calculated for
+    long                    result_scales;              //number of scales in result
+    double                  result[3 * SC_UTIL_APEN_MAX_SCALES]; //values of the last calculation
+    double                  ci[2 * SC_UTIL_APEN_MAX_SCALES]; //confidence interval of the ApEn values in result, low and high for each scale
+    long                    estimate_samples;           //number of reference windows sampled by calculations, 0 for every window
+    unsigned long           estimate_seed;              //seed for the choice of sampled windows
+    double*                 test_value;                 //holds data series, one mirrored ring buffer of 2 * series_max_length values per vector dimension, see sc_util_apen_core_append
+    long                    series_head;                //index of the oldest value in test_value, the series is always test_value[series_head ... series_head + series_length - 1]
+    long*                   match_count0;               //number of templates of size pattern_length matching each template, sized 2 * series_max_length
+    long*                   match_count1;               //number of templates of size pattern_length + 1 matching each template, sized 2 * series_max_length
+    long                    count_head;                 //index of the count for the oldest template in match_count0/match_count1, back to 0 whenever counts_valid is cleared
+    double*                 scale_buffer;               //prefix sums and the coarse-grained series for scales > 1, shared by every scale
+    long*                   scale_count;                //match counts for the coarse-grained series, two halves of series_max_length
+    long                    scale_capacity;             //number of doubles scale_buffer can hold
+    long                    scale_count_capacity;       //number of longs scale_count can hold
+    void*                   work;                       //work memory for the counting kernels, sized with the series so calculations never allocate
+    t_sc_util_apen_stats    stats;                      //comparisons made by calculations and by the incremental counts
+} t_sc_util_apen_core;
+
+long sc_util_apen_core_init(t_sc_util_apen_core *c, long max_length, long dims); //allocates an empty series, returns 0 if there is not enough memory
+void sc_util_apen_core_free(t_sc_util_apen_core *c);
+void sc_util_apen_core_clear(t_sc_util_apen_core *c); //empties the series
+long sc_util_apen_core_set_max_length(t_sc_util_apen_core *c, long max_length); //resizes the series keeping the most recent values, returns 0 if there is not enough memory
+long sc_util_apen_core_set_vector_size(t_sc_util_apen_core *c, long dims); //changes the vector size and empties the series, returns 0 if there is not enough memory
+void sc_util_apen_core_set_pattern_length(t_sc_util_apen_core *c, long m);
+void sc_util_apen_core_set_similarity(t_sc_util_apen_core *c, double r); //sets r, or k in relative mode
+void sc_util_apen_core_set_similarity_mode(t_sc_util_apen_core *c, long mode);
+void sc_util_apen_core_update_similarity(t_sc_util_apen_core *c); //sets r from similarity_factor, and the standard deviation in relative mode
+void sc_util_apen_core_restat(t_sc_util_apen_core *c); //recomputes running_mean and running_m2 from the series and updates r
+void sc_util_apen_core_add_value(t_sc_util_apen_core *c, double v, long delta); //adds (delta = 1) or removes (delta = -1) one value from the running mean and variance
+double sc_util_apen_sd(double* series, long length, long dims, long stride); //standard deviation of every value of the series, all dimensions together
+void sc_util_apen_core_set_incremental(t_sc_util_apen_core *c, long incremental); //sets whether the match counts follow the input, they are recounted on the next calculation
+
+void sc_util_apen_core_append(t_sc_util_apen_core *c, double* d); //adds a single vector of series_vector_size values to the series
+void sc_util_apen_core_append_list(t_sc_util_apen_core *c, double* d, long count); //adds count vectors stored one after the other
+long sc_util_apen_core_calculate(t_sc_util_apen_core *c, long mode, long scales, double* result); //fills result with 3 values per scale, returns 0 (and zeros) if the series is too short or there is no memory for scales > 1
+long sc_util_apen_core_cached(t_sc_util_apen_core *c, long mode, long scales, double* result); //fills result from the last calculation if nothing changed since, returns 0 otherwise
+void sc_util_apen_core_store(t_sc_util_apen_core *c, long version, long mode, long scales, double* result, double* ci); //keeps a result (and its confidence intervals, may be NULL) calculated elsewhere for version of the series
+void sc_util_apen_core_set_estimate(t_sc_util_apen_core *c, long samples, unsigned long seed); //sets the number of windows sampled by calculations and the seed choosing them
+void sc_util_apen_core_changed(t_sc_util_apen_core *c); //drops the cached result and match counts
+void sc_util_apen_core_copy(t_sc_util_apen_core *c, double* out); //copies the series oldest first, one dimension after another
+void sc_util_apen_core_snapshot(t_sc_util_apen_core *c, t_sc_util_apen_core *out); //copies the series and everything a calculation reads into out, made with the same series_max_length and series_vector_size
+
+void sc_util_apen_update_counts(t_sc_util_apen_core *c, long t0, long t1, long delta); //add or remove one template of each size from the match counts
+void sc_util_apen_update_template(t_sc_util_apen_core *c, long t, long use0, long use1, long delta); //compare one window against every other window and apply delta to the counts of similar ones
+
+void sc_util_apen_estimate(double* series, long length, long dims, long stride, long m, double r, long mode, long* c0, long* c1, long counts_ready, double* result, void* work, t_sc_util_apen_stats* stats, t_sc_util_apen_sampling* sampling); //fills result with the ApEn, SampEn and FuzzyEn values mode asks for
+void sc_util_apen_multiscale(double* series, long length, long dims, long stride, long m, double r, long mode, long scales, double* scratch, long* c0, long* c1, double* result, void* work, t_sc_util_apen_stats* stats, t_sc_util_apen_sampling* sampling); //fills result with the values of the coarse-grained series at scales 2 ... scales
+
+#endif
@@ -0,0 +1,965 @@
+/**
+	@file
+	sc.util.apen.kernel - template counting shared by sc.apen and sc.apen~
+	Connor Rawls - cwrawls@asu.edu
+
+    Copyright Synthesis Center, Arizona State University, 2018
+ 
+	@ingroup    analysis-utilities
+*/
+
+#include "sc.util.apen.kernel.h"
+
+//block comparison used by every object, chosen once when the class is created
+t_sc_util_apen_match_block sc_util_apen_match_block = sc_util_apen_match_block_scalar;
+
+//bytes of work memory sc_util_apen_count_all and sc_util_apen_fuzzyen need for a series of length values
+/* Callers that calculate repeatedly keep one block of this size so the calculations themselves never allocate. */
+size_t sc_util_apen_work_size(long length, long dims) {
+    size_t keys = sizeof(t_sc_util_apen_key) * length;
+    size_t means = sizeof(double) * length * dims * 2;
+    size_t hashed = sizeof(long) * length * 2 + sizeof(t_sc_util_apen_slot) * length * 4; //the table has up to 4 slots per window
+    size_t size = (keys > means) ? keys : means;
+    return (hashed > size) ? hashed : size;
+}
+
+//fills match_count0 and match_count1 with the number of similar windows for every window in the series
+/* series holds dims dimensions of length values each, dimension k starting at series + k * stride.
+ Windows are similar when every value of every dimension is within r.
+ 
+ Series of whole numbers (symbols, states, MIDI values) with r < 1 only match identical windows and are counted
+ with a hash table in O(N). Long series first try the sorted neighbour search, which declines when it would not save work,
+ everything else compares every pair of windows. work is NULL or sc_util_apen_work_size(length, dims) bytes.
+ */
+double sc_util_apen_count_all(double* series, long length, long dims, long stride, long m, double r, long* c0, long* c1, void* work) {
+    long n0 = length - m + 1;
+    
+    if(r < 1.0 && sc_util_apen_discrete(series, length, dims, stride)) {
+        double pairs = sc_util_apen_count_hashed(series, length, dims, stride, m, c0, c1, work);
+        if(pairs >= 0) {
+            return pairs;
+        }
+    }
+    if(n0 >= SC_UTIL_APEN_SORTED_MIN) {
+        double pairs = sc_util_apen_count_sorted(series, length, dims, stride, m, r, c0, c1, work);
+        if(pairs >= 0) {
+            return pairs;
+        }
+    }
+    return sc_util_apen_count_pairs(series, length, dims, stride, m, r, c0, c1);
+}
+
+//counts similar windows by comparing every pair of windows
+/* Both pattern sizes are counted in a single pass over the pairs of windows.
+ A pair can only match at pattern_length + 1 if it already matches at pattern_length,
+ so sc_util_apen_match only compares the one extra element for pairs that passed the first test.
+ 
+ The maximum distance is symmetric and every window matches itself, so only pairs i < j are compared
+ and each match is added to the counts of both windows. This gives the same counts as comparing
+ every ordered pair with half the work.
+ */
+double sc_util_apen_count_pairs(double* series, long length, long dims, long stride, long m, double r, long* c0, long* c1) {
+    long n0 = length - m + 1; //number of windows of size m
+    long n1 = length - m;     //number of windows of size m + 1
+    t_sc_util_apen_match_block match_block = sc_util_apen_match_block_for(m);
+    t_sc_util_apen_match match_pair = sc_util_apen_match_for(m);
+    
+    //every window is similar to itself
+    for(int i = 0; i < n0; i++) {
+        c0[i] = 1;
+        if(i < n1) {
+            c1[i] = 1;
+        }
+    }
+    
+    //temporary pointer to the data set
+    double* temp = series;
+    
+    //outer loop for iterating through each possible window included in the data set of size m (pattern length)
+    for(int i = 0; i < n0; i++, temp++) {
+        double* temp2 = temp + 1; //second temporary pointer to data set, starting at the window after the current one
+        int j = i + 1;
+        
+        //compare blocks of windows at once while every window in the block also has a window of size m + 1
+        for(; j + SC_UTIL_APEN_BLOCK <= n1; j += SC_UTIL_APEN_BLOCK, temp2 += SC_UTIL_APEN_BLOCK) {
+            long mask1 = 0;
+            long mask0 = match_block(temp, temp2, m, dims, stride, r, &mask1);
+            for(int b = 0; mask0 && b < SC_UTIL_APEN_BLOCK; b++) {
+                if(mask0 & (1 << b)) {
+                    c0[i]++;
+                    c0[j + b]++;
+                }
+                if(mask1 & (1 << b)) {
+                    c1[i]++;
+                    c1[j + b]++;
+                }
+            }
+        }
+        
+        //inner loop, iterate through the remaining windows of size m to compare against the current window from the outer loop
+        for(; j < n0; j++, temp2++) {
+            //windows are similar if the maximum distance between their elements is less than or equal to the similarity index
+            long match = match_pair(temp, temp2, m, dims, stride, (j < n1), r);
+            if(match > 0) {
+                c0[i]++;
+                c0[j]++;
+            }
+            if(match > 1) {
+                c1[i]++;
+                c1[j]++;
+            }
+        }
+    }
+    
+    return (double)n0 * (n0 - 1) / 2;
+}
+
+//counts similar windows by only comparing windows whose first elements are within the similarity index
+/* Two windows can only be similar if their first elements are no more than r apart (in the first dimension).
+ After sorting the windows by their first element, the candidates for each window are the ones
+ directly after it in sorted order up to the first one more than r away, and only those get the full comparison.
+ For signals that spread over many multiples of r this brings the count close to O(N log N).
+ 
+ Sorting costs O(N log N) before any comparison is saved, and when most pairs are candidates
+ the scattered comparisons are slower than the block kernel of sc_util_apen_count_pairs.
+ The number of candidates is known before any comparison is made, so this declines (returns -1)
+ when more than a quarter of all pairs are candidates, or when the series holds values that do not sort (NaN, inf).
+ Otherwise it returns the number of candidate pairs compared.
+ The sorting keys are kept in work if it is not NULL, see sc_util_apen_work_size.
+ */
+double sc_util_apen_count_sorted(double* series, long length, long dims, long stride, long m, double r, long* c0, long* c1, void* work) {
+    long n0 = length - m + 1;
+    long n1 = length - m;
+    t_sc_util_apen_match match_pair = sc_util_apen_match_for(m);
+    
+    t_sc_util_apen_key* keys = work ? (t_sc_util_apen_key*)work : (t_sc_util_apen_key*)malloc(sizeof(t_sc_util_apen_key) * n0);
+    if(!keys) {
+        return -1;
+    }
+    
+    for(int i = 0; i < n0; i++) {
+        if(!isfinite(series[i])) {
+            if(!work) {
+                free(keys);
+            }
+            return -1;
+        }
+        keys[i].value = series[i];
+        keys[i].index = i;
+    }
+    qsort(keys, n0, sizeof(t_sc_util_apen_key), sc_util_apen_key_compare);
+    
+    //count the candidate pairs before comparing anything
+    double candidates = 0;
+    long hi = 0;
+    for(int a = 0; a < n0; a++) {
+        if(hi < a + 1) {
+            hi = a + 1;
+        }
+        while(hi < n0 && keys[hi].value - keys[a].value <= r) {
+            hi++;
+        }
+        candidates += hi - a - 1;
+    }
+    if(candidates * 4 > (double)n0 * (n0 - 1) / 2) {
+        if(!work) {
+            free(keys);
+        }
+        return -1;
+    }
+    
+    //every window is similar to itself
+    for(int i = 0; i < n0; i++) {
+        c0[i] = 1;
+        if(i < n1) {
+            c1[i] = 1;
+        }
+    }
+    
+    for(int a = 0; a < n0; a++) {
+        for(int b = a + 1; b < n0 && keys[b].value - keys[a].value <= r; b++) {
+            long i = keys[a].index;
+            long j = keys[b].index;
+            long match = match_pair(series + i, series + j, m, dims, stride, (i < n1 && j < n1), r);
+            if(match > 0) {
+                c0[i]++;
+                c0[j]++;
+            }
+            if(match > 1) {
+                c1[i]++;
+                c1[j]++;
+            }
+        }
+    }
+    
+    if(!work) {
+        free(keys);
+    }
+    return candidates;
+}
+
+//counts identical windows with a hash table instead of comparing pairs
+/* Two windows of whole numbers are within r < 1 of each other exactly when they are identical, so each window's count
+ is the size of its group of identical windows. Windows of size m are grouped by a rolling hash of their values,
+ which moves to the next window in O(dims); windows of size m + 1 are grouped by their group at size m and their
+ last value. Hash matches are checked against the first window of the group, so collisions never merge groups and
+ the counts are exactly those of sc_util_apen_count_pairs, in O(N) instead of O(N^2).
+ 
+ work (or memory allocated here if it is NULL) holds the group of every window and a table of 2 to 4 slots per window.
+ Returns the number of pairs of windows compared, one per window looked up against its group, or -1 if there was no memory.
+ */
+double sc_util_apen_count_hashed(double* series, long length, long dims, long stride, long m, long* c0, long* c1, void* work) {
+    const unsigned long long base = 0x100000001b3ULL;      //rolling hash multiplier
+    const unsigned long long mix = 0x9E3779B97F4A7C15ULL;  //spreads hashes over the table
+    long n0 = length - m + 1;
+    long n1 = length - m;
+    long bits = 1;
+    while((1L << bits) < 2 * n0) {
+        bits++;
+    }
+    long cap = 1L << bits;
+    
+    long* group0 = work ? (long*)work : (long*)malloc(sizeof(long) * length * 2 + sizeof(t_sc_util_apen_slot) * cap);
+    if(!group0) {
+        return -1;
+    }
+    long* group1 = group0 + length;
+    t_sc_util_apen_slot* table = (t_sc_util_apen_slot*)(group1 + length);
+    double pairs = 0;
+    
+    //base^(m - 1), to take the oldest value out of the rolling hash
+    unsigned long long top = 1;
+    for(int q = 1; q < m; q++) {
+        top *= base;
+    }
+    
+    //windows of size m
+    for(long t = 0; t < cap; t++) {
+        table[t].index = -1;
+    }
+    unsigned long long roll[SC_UTIL_APEN_HASH_DIMS];
+    for(int k = 0; k < dims && k < SC_UTIL_APEN_HASH_DIMS; k++) {
+        roll[k] = 0;
+        for(int q = 0; q < m; q++) {
+            roll[k] = roll[k] * base + (unsigned long long)(long long)series[k * stride + q];
+        }
+    }
+    for(long i = 0; i < n0; i++) {
+        unsigned long long h = 0;
+        for(int k = 0; k < dims; k++) {
+            unsigned long long v = 0;
+            if(k < SC_UTIL_APEN_HASH_DIMS) {
+                v = roll[k];
+            } else {
+                //dimensions past the rolling ones are hashed in full
+                for(int q = 0; q < m; q++) {
+                    v = v * base + (unsigned long long)(long long)series[k * stride + i + q];
+                }
+            }
+            h = (h ^ v) * mix;
+        }
+        
+        long slot = (long)((h * mix) >> (64 - bits));
+        while(1) {
+            if(table[slot].index < 0) {
+                table[slot].hash = h;
+                table[slot].index = i;
+                group0[i] = i;
+                break;
+            }
+            if(table[slot].hash == h) {
+                long j = table[slot].index;
+                long same = 1;
+                pairs++;
+                for(int k = 0; same && k < dims; k++) {
+                    for(int q = 0; q < m; q++) {
+                        if(series[k * stride + i + q] != series[k * stride + j + q]) {
+                            same = 0;
+                            break;
+                        }
+                    }
+                }
+                if(same) {
+                    group0[i] = j;
+                    break;
+                }
+            }
+            slot = (slot + 1) & (cap - 1);
+        }
+        
+        if(i + 1 < n0) {
+            for(int k = 0; k < dims && k < SC_UTIL_APEN_HASH_DIMS; k++) {
+                double* d = series + k * stride;
+                roll[k] = (roll[k] - (unsigned long long)(long long)d[i] * top) * base + (unsigned long long)(long long)d[i + m];
+            }
+        }
+    }
+    
+    //windows of size m + 1, the same group at size m and the same next value
+    for(long t = 0; t < cap; t++) {
+        table[t].index = -1;
+    }
+    for(long i = 0; i < n1; i++) {
+        unsigned long long h = (unsigned long long)group0[i] * mix;
+        for(int k = 0; k < dims; k++) {
+            h = (h ^ (unsigned long long)(long long)series[k * stride + i + m]) * mix;
+        }
+        
+        long slot = (long)((h * mix) >> (64 - bits));
+        while(1) {
+            if(table[slot].index < 0) {
+                table[slot].hash = h;
+                table[slot].index = i;
+                group1[i] = i;
+                break;
+            }
+            if(table[slot].hash == h) {
+                long j = table[slot].index;
+                long same = (group0[j] == group0[i]);
+                pairs++;
+                for(int k = 0; same && k < dims; k++) {
+                    same = (series[k * stride + i + m] == series[k * stride + j + m]);
+                }
+                if(same) {
+                    group1[i] = j;
+                    break;
+                }
+            }
+            slot = (slot + 1) & (cap - 1);
+        }
+    }
+    
+    //the first window of a group counts its members, every member then takes that count
+    for(long i = 0; i < n0; i++) {
+        c0[i] = 0;
+        if(i < n1) {
+            c1[i] = 0;
+        }
+    }
+    for(long i = 0; i < n0; i++) {
+        c0[group0[i]]++;
+        if(i < n1) {
+            c1[group1[i]]++;
+        }
+    }
+    for(long i = 0; i < n0; i++) {
+        c0[i] = c0[group0[i]];
+        if(i < n1) {
+            c1[i] = c1[group1[i]];
+        }
+    }
+    
+    if(!work) {
+        free(group0);
+    }
+    return pairs;
+}
+
+//returns 1 if every value of the series is a whole number that converts to an integer exactly, 0 for anything else (NaN and inf included)
+long sc_util_apen_discrete(double* series, long length, long dims, long stride) {
+    for(int k = 0; k < dims; k++) {
+        double* d = series + k * stride;
+        for(int t = 0; t < length; t++) {
+            if(!(d[t] == floor(d[t]) && fabs(d[t]) < 9007199254740992.0)) {
+                return 0;
+            }
+        }
+    }
+    return 1;
+}
+
+int sc_util_apen_key_compare(const void* a, const void* b) {
+    double va = ((t_sc_util_apen_key*)a)->value;
+    double vb = ((t_sc_util_apen_key*)b)->value;
+    return (va > vb) - (va < vb);
+}
+
+//counts similar windows for several similarity values at once
+/* The distance of every pair of windows is found once, for size m and m + 1, and binned by the smallest r
+ (of the nr values in r, sorted ascending) it is within. A running sum over the bins then gives the counts
+ for every r, so adding more r values costs a binary search per pair rather than another pass.
+ c0 and c1 hold nr rows of length - m + 1 counts, row k being the counts for r[k].
+ */
+void sc_util_apen_count_sweep(double* series, long length, long dims, long stride, long m, double* r, long nr, long* c0, long* c1) {
+    long n0 = length - m + 1;
+    long n1 = length - m;
+    
+    for(int k = 0; k < nr * n0; k++) {
+        c0[k] = 0;
+        c1[k] = 0;
+    }
+    //every window is similar to itself at every r
+    for(int i = 0; i < n0; i++) {
+        c0[i] = 1;
+        if(i < n1) {
+            c1[i] = 1;
+        }
+    }
+    
+    for(int i = 0; i < n0; i++) {
+        for(int j = i + 1; j < n0; j++) {
+            //maximum distance at size m, and at m + 1 including the extra element, NaN elements are skipped like sc_util_apen_match
+            double md = 0.0;
+            double md1 = 0.0;
+            for(int k = 0; k < dims; k++) {
+                double* d0 = series + k * stride + i;
+                double* d1 = series + k * stride + j;
+                for(int q = 0; q < m; q++) {
+                    double t = fabs(d0[q] - d1[q]);
+                    if(t > md) {
+                        md = t;
+                    }
+                }
+                if(j < n1) {
+                    double t = fabs(d0[m] - d1[m]);
+                    if(t > md1) {
+                        md1 = t;
+                    }
+                }
+            }
+            if(md > md1) {
+                md1 = md;
+            }
+            
+            //first bin whose r the pair is within, nr if none
+            long lo = 0;
+            long hi = nr;
+            while(lo < hi) {
+                long mid = (lo + hi) / 2;
+                if(md <= r[mid]) {
+                    hi = mid;
+                } else {
+                    lo = mid + 1;
+                }
+            }
+            if(lo < nr) {
+                c0[lo * n0 + i]++;
+                c0[lo * n0 + j]++;
+            }
+            if(j >= n1) {
+                continue;
+            }
+            
+            lo = 0;
+            hi = nr;
+            while(lo < hi) {
+                long mid = (lo + hi) / 2;
+                if(md1 <= r[mid]) {
+                    hi = mid;
+                } else {
+                    lo = mid + 1;
+                }
+            }
+            if(lo < nr) {
+                c1[lo * n0 + i]++;
+                c1[lo * n0 + j]++;
+            }
+        }
+    }
+    
+    //a pair within r[k] is within every larger r
+    for(int k = 1; k < nr; k++) {
+        for(int i = 0; i < n0; i++) {
+            c0[k * n0 + i] += c0[(k - 1) * n0 + i];
+            c1[k * n0 + i] += c1[(k - 1) * n0 + i];
+        }
+    }
+}
+
+//Approximate Entropy from the current match counts, ln(Ci(m) / Ci(m+1))
+double sc_util_apen_from_counts(long length, long m, long* c0, long* c1) {
+    long n0 = length - m + 1;
+    long n1 = length - m;
+    
+    double avg_ratio0 = 0; //average number of windows within the similarity index for Cm(0...i)
+    for(int i = 0; i < n0; i++) {
+        //get the percent of windows similar enough (total # of similar windows / total number of windows)
+        avg_ratio0 += (double)c0[i] / n0;
+    }
+    //take the average percentage (Ci(m))
+    avg_ratio0 /= n0;
+    
+    double avg_ratio1 = 0;
+    for(int i = 0; i < n1; i++) {
+        avg_ratio1 += (double)c1[i] / n1;
+    }
+    //Ci(m+1)
+    avg_ratio1 /= n1;
+    
+    //Natural Logarithm of (Ci(m) / Ci(m)+1)
+    return log(avg_ratio0 / ((avg_ratio1 > 0.0) ? avg_ratio1 : 0.0000001)); //included a way to avoid division by 0 errors
+}
+
+//Sample Entropy from the same match counts, ln(B / A)
+/* B is the number of pairs of windows of size m that match and A the number of pairs of size m + 1 that match,
+ both taken over the first length - m windows and without self matches. Every count already holds both
+ directions of each pair, so summing them gives 2B and 2A, and the last window of size m (which has no
+ window of size m + 1) is taken back out of B. This is O(N) on top of the counts ApEn uses.
+ 
+ If no pair matches at m + 1 SampEn is undefined, the largest value the series can show,
+ ln((N - m)(N - m - 1) / 2), is returned instead.
+ */
+double sc_util_apen_sampen_from_counts(long length, long m, long* c0, long* c1) {
+    long n0 = length - m + 1;
+    long n1 = length - m;
+    
+    double b = 0;
+    double a = 0;
+    for(int i = 0; i < n1; i++) {
+        b += c0[i] - 1;
+        a += c1[i] - 1;
+    }
+    b -= c0[n0 - 1] - 1;
+    
+    if(a <= 0 || b <= 0) {
+        return log((double)n1 * (n1 - 1) / 2);
+    }
+    return log(b / a);
+}
+
+//ApEn and SampEn estimated from samples reference windows instead of every window
+/* Each reference window is picked at random (with replacement) from the windows that have a window of size m + 1,
+ and its matches are counted against every window of the series, so the cost is samples * N instead of N^2 / 2.
+ The estimators are those of sc_util_apen_from_counts and sc_util_apen_sampen_from_counts taken over the sampled
+ windows only. The same seed always picks the same windows.
+ 
+ result receives ApEn and SampEn, ci the low and high end of a 95% confidence interval for ApEn. ApEn is the log of
+ a ratio of two means, its standard error comes from the variances and covariance of the sampled match ratios
+ (the delta method). pairs receives the number of pairs of windows compared and misses how many did not match
+ at pattern_length.
+ */
+void sc_util_apen_sampled(double* series, long length, long dims, long stride, long m, double r, long samples, unsigned long seed, double* result, double* ci, double* pairs, double* misses) {
+    long n0 = length - m + 1;
+    long n1 = length - m;
+    t_sc_util_apen_match_block match_block = sc_util_apen_match_block_for(m);
+    t_sc_util_apen_match match_pair = sc_util_apen_match_for(m);
+    unsigned long state = (seed & 0xffffffffUL) ? seed : 1; //xorshift never leaves 0
+    
+    double sum0 = 0, sum1 = 0;        //sums of the match ratios at m and m + 1
+    double sq0 = 0, sq1 = 0, sq01 = 0; //sums of their squares and products
+    double b = 0, a = 0;               //matching pairs for SampEn, as in sc_util_apen_sampen_from_counts
+    double missed = 0;
+    
+    for(long k = 0; k < samples; k++) {
+        long i = (long)(sc_util_apen_random(&state) * n1);
+        if(i >= n1) {
+            i = n1 - 1;
+        }
+        double* temp = series + i;
+        double* temp2 = series;
+        long c0 = 0;
+        long c1 = 0;
+        long last = 0; //whether the last window of size m matches, it has no window of size m + 1
+        int j = 0;
+        
+        for(; j + SC_UTIL_APEN_BLOCK <= n1; j += SC_UTIL_APEN_BLOCK, temp2 += SC_UTIL_APEN_BLOCK) {
+            long mask1 = 0;
+            long mask0 = match_block(temp, temp2, m, dims, stride, r, &mask1);
+            for(int q = 0; mask0 && q < SC_UTIL_APEN_BLOCK; q++) {
+                c0 += (mask0 >> q) & 1;
+                c1 += (mask1 >> q) & 1;
+            }
+        }
+        for(; j < n0; j++, temp2++) {
+            long match = match_pair(temp, temp2, m, dims, stride, (j < n1), r);
+            if(match > 0) {
+                c0++;
+                if(j == n0 - 1) {
+                    last = 1;
+                }
+            }
+            if(match > 1) {
+                c1++;
+            }
+        }
+        
+        double r0 = (double)c0 / n0;
+        double r1 = (double)c1 / n1;
+        sum0 += r0;
+        sum1 += r1;
+        sq0 += r0 * r0;
+        sq1 += r1 * r1;
+        sq01 += r0 * r1;
+        b += c0 - 1 - last;
+        a += c1 - 1;
+        missed += n0 - c0;
+    }
+    
+    double avg0 = sum0 / samples;
+    double avg1 = sum1 / samples;
+    result[0] = log(avg0 / ((avg1 > 0.0) ? avg1 : 0.0000001)); //included a way to avoid division by 0 errors
+    result[1] = (a <= 0 || b <= 0) ? log((double)n1 * (n1 - 1) / 2) : log(b / a);
+    
+    double half = 0.0;
+    if(samples > 1 && avg1 > 0.0) {
+        double scale = (double)samples / (samples - 1); //sample variances
+        double var0 = (sq0 / samples - avg0 * avg0) * scale;
+        double var1 = (sq1 / samples - avg1 * avg1) * scale;
+        double cov = (sq01 / samples - avg0 * avg1) * scale;
+        double var = (var0 / (avg0 * avg0) + var1 / (avg1 * avg1) - 2 * cov / (avg0 * avg1)) / samples;
+        half = (var > 0.0) ? 1.96 * sqrt(var) : 0.0;
+    }
+    ci[0] = result[0] - half;
+    ci[1] = result[0] + half;
+    *pairs = (double)samples * (n0 - 1);
+    *misses = missed;
+}
+
+double sc_util_apen_random(unsigned long* state) {
+    //xorshift, the same series on every machine for a given seed
+    unsigned long s = *state & 0xffffffffUL;
+    s ^= (s << 13) & 0xffffffffUL;
+    s ^= s >> 17;
+    s ^= (s << 5) & 0xffffffffUL;
+    *state = s;
+    return (double)s / 4294967296.0;
+}
+
+//Fuzzy Entropy, ln(phi(m) / phi(m+1))
+/* Each window has its own mean (per dimension) taken away, and instead of counting matches every pair adds
+ its similarity exp(-d^2 / r), with d the maximum distance between the two windows. Both sizes use the first
+ length - m windows. The similarity needs the real distance of every pair, so this has its own pass and
+ cannot use the block comparisons or the counts. The window means are kept in work if it is not NULL.
+ */
+double sc_util_apen_fuzzyen(double* series, long length, long dims, long stride, long m, double r, void* work) {
+    long n = length - m; //number of windows of each size
+    
+    if(n < 2) {
+        return 0.0;
+    }
+    
+    //mean of every window, mean0 for size m and mean1 for size m + 1, n values per dimension
+    double* mean0 = work ? (double*)work : (double*)malloc(sizeof(double) * n * dims * 2);
+    if(!mean0) {
+        return 0.0;
+    }
+    double* mean1 = mean0 + n * dims;
+    for(int k = 0; k < dims; k++) {
+        double* d = series + k * stride;
+        for(int i = 0; i < n; i++) {
+            double sum = 0;
+            for(int q = 0; q < m; q++) {
+                sum += d[i + q];
+            }
+            mean0[k * n + i] = sum / m;
+            mean1[k * n + i] = (sum + d[i + m]) / (m + 1);
+        }
+    }
+    
+    double phi0 = 0;
+    double phi1 = 0;
+    for(int i = 0; i < n; i++) {
+        for(int j = i + 1; j < n; j++) {
+            double md0 = 0.0;
+            double md1 = 0.0;
+            for(int k = 0; k < dims; k++) {
+                double* d0 = series + k * stride + i;
+                double* d1 = series + k * stride + j;
+                double base0 = mean0[k * n + i] - mean0[k * n + j];
+                double base1 = mean1[k * n + i] - mean1[k * n + j];
+                for(int q = 0; q < m; q++) {
+                    double diff = d0[q] - d1[q];
+                    double t0 = fabs(diff - base0);
+                    double t1 = fabs(diff - base1);
+                    if(t0 > md0) {
+                        md0 = t0;
+                    }
+                    if(t1 > md1) {
+                        md1 = t1;
+                    }
+                }
+                double t1 = fabs(d0[m] - d1[m] - base1);
+                if(t1 > md1) {
+                    md1 = t1;
+                }
+            }
+            //r is 0 for a constant series in relative mode, only identical windows are then similar
+            phi0 += (r > 0.0) ? exp(-(md0 * md0) / r) : (md0 == 0.0);
+            phi1 += (r > 0.0) ? exp(-(md1 * md1) / r) : (md1 == 0.0);
+        }
+    }
+    if(!work) {
+        free(mean0);
+    }
+    
+    //both sums cover the same n (n - 1) / 2 pairs, so the normalisation cancels
+    return log(phi0 / ((phi1 > 0.0) ? phi1 : 0.0000001));
+}
+
+//function for calculating the maximum pair-wise distance of members between two vectors
+/* The function only compares members at matching indeces.
+ Example:
+ 
+ Vec1:          Vec2:           Dist:
+ 1     ->       5        =      4
+ 2     ->       4        =      2
+ 3     ->       3        =      0
+ 4     ->       2        =      2
+ 5     ->       1        =      4
+ 
+ Maximum Distance : 4
+ 
+ */
+
+/* Paramters
+ d0 - Double pointer to vector 0
+ d1 - Double pointer to vector 1
+ l - long size of both vectors, vectors should be the same length
+ r - similarity index. used for optimizing when a distance is greater than the similarity index.
+ */
+double sc_util_apen_maxdist(double* d0, double* d1, long l, double r) {
+    double md = 0.0;
+    
+    double* t = d0;
+    double* t1 = d1;
+    for(int i = 0; i < l; i++, t++, t1++) {
+        double dist = fabs(*t1 - *t);
+        md = (dist > md) ? dist : md;
+        if(md > r) { //if the distance exceeds the similarity index r, just return the value, no need to calculate further
+            return md;
+        }
+    }
+    
+    return md;
+}
+
+//function for deciding whether two patterns are similar at length l and at length l + 1
+/* Patterns have dims dimensions, dimension k starting stride values after dimension k - 1,
+ and are similar when every dimension is.
+ Returns 0 if the patterns are not similar at length l,
+ 1 if they are similar at length l only (or extend is not set),
+ 2 if they are similar at both lengths.
+ The element at index l is only read when extend is set and the first l elements matched.
+ 
+ The body is inlined into sc_util_apen_match and into one copy for each fixed length, see sc_util_apen_match_for.
+ */
+SC_UTIL_APEN_INLINE long sc_util_apen_match_body(double* d0, double* d1, long l, long dims, long stride, long extend, double r) {
+    for(int k = 0; k < dims; k++) {
+        double* t = d0 + k * stride;
+        double* t1 = d1 + k * stride;
+        for(int i = 0; i < l; i++) {
+            if(fabs(t1[i] - t[i]) > r) { //the distance exceeds the similarity index r, no need to calculate further
+                return 0;
+            }
+        }
+    }
+    if(!extend) {
+        return 1;
+    }
+    for(int k = 0; k < dims; k++) {
+        if(fabs(d1[k * stride + l] - d0[k * stride + l]) > r) {
+            return 1;
+        }
+    }
+    return 2;
+}
+
+long sc_util_apen_match(double* d0, double* d1, long l, long dims, long stride, long extend, double r) {
+    return sc_util_apen_match_body(d0, d1, l, dims, stride, extend, r);
+}
+
+//function for comparing one window against SC_UTIL_APEN_BLOCK windows starting at consecutive indeces
+/* Instead of a distance, returns a mask with bit b set when d0 is similar to the window starting at d1 + b at length l.
+ mask1 receives the same for length l + 1, so d0[l] and d1[l ... l + SC_UTIL_APEN_BLOCK - 1] must be readable in every dimension.
+ Because the candidate windows overlap, element k of every candidate is one contiguous load from d1 + k,
+ which is what lets the SSE2 and AVX2 versions below compare all of them at once.
+ All versions must give exactly the masks of calling sc_util_apen_match on each candidate.
+ */
+SC_UTIL_APEN_INLINE long sc_util_apen_match_block_scalar_body(double* d0, double* d1, long l, long dims, long stride, double r, long* mask1) {
+    long mask0 = 0;
+    *mask1 = 0;
+    for(int b = 0; b < SC_UTIL_APEN_BLOCK; b++) {
+        long match = sc_util_apen_match_body(d0, d1 + b, l, dims, stride, 1, r);
+        if(match > 0) {
+            mask0 |= (1 << b);
+        }
+        if(match > 1) {
+            *mask1 |= (1 << b);
+        }
+    }
+    return mask0;
+}
+
+long sc_util_apen_match_block_scalar(double* d0, double* d1, long l, long dims, long stride, double r, long* mask1) {
+    return sc_util_apen_match_block_scalar_body(d0, d1, l, dims, stride, r, mask1);
+}
+
+#ifdef SC_UTIL_APEN_X86
+SC_UTIL_APEN_TARGET("sse2")
+SC_UTIL_APEN_INLINE long sc_util_apen_match_block_sse2_body(double* d0, double* d1, long l, long dims, long stride, double r, long* mask1) {
+    const __m128d sign = _mm_set1_pd(-0.0);
+    const __m128d rv = _mm_set1_pd(r);
+    __m128d far_lo = _mm_setzero_pd(); //lanes that have exceeded r, candidates 0 and 1
+    __m128d far_hi = _mm_setzero_pd(); //candidates 2 and 3
+    
+    for(int q = 0; q < dims; q++) {
+        double* p0 = d0 + q * stride;
+        double* p1 = d1 + q * stride;
+        for(int k = 0; k < l; k++) {
+            __m128d a = _mm_set1_pd(p0[k]);
+            __m128d lo = _mm_andnot_pd(sign, _mm_sub_pd(_mm_loadu_pd(p1 + k), a));
+            __m128d hi = _mm_andnot_pd(sign, _mm_sub_pd(_mm_loadu_pd(p1 + k + 2), a));
+            far_lo = _mm_or_pd(far_lo, _mm_cmpgt_pd(lo, rv));
+            far_hi = _mm_or_pd(far_hi, _mm_cmpgt_pd(hi, rv));
+            if((_mm_movemask_pd(far_lo) & _mm_movemask_pd(far_hi)) == 3) { //every candidate is too far away, no need to calculate further
+                *mask1 = 0;
+                return 0;
+            }
+        }
+    }
+    long mask0 = (~(_mm_movemask_pd(far_lo) | (_mm_movemask_pd(far_hi) << 2))) & 0xF;
+    
+    for(int q = 0; q < dims; q++) {
+        __m128d a = _mm_set1_pd(d0[q * stride + l]);
+        __m128d lo = _mm_andnot_pd(sign, _mm_sub_pd(_mm_loadu_pd(d1 + q * stride + l), a));
+        __m128d hi = _mm_andnot_pd(sign, _mm_sub_pd(_mm_loadu_pd(d1 + q * stride + l + 2), a));
+        far_lo = _mm_or_pd(far_lo, _mm_cmpgt_pd(lo, rv));
+        far_hi = _mm_or_pd(far_hi, _mm_cmpgt_pd(hi, rv));
+    }
+    *mask1 = (~(_mm_movemask_pd(far_lo) | (_mm_movemask_pd(far_hi) << 2))) & 0xF;
+    
+    return mask0;
+}
+
+SC_UTIL_APEN_TARGET("sse2")
+long sc_util_apen_match_block_sse2(double* d0, double* d1, long l, long dims, long stride, double r, long* mask1) {
+    return sc_util_apen_match_block_sse2_body(d0, d1, l, dims, stride, r, mask1);
+}
+
+SC_UTIL_APEN_TARGET("avx2")
+SC_UTIL_APEN_INLINE long sc_util_apen_match_block_avx2_body(double* d0, double* d1, long l, long dims, long stride, double r, long* mask1) {
+    const __m256d sign = _mm256_set1_pd(-0.0);
+    const __m256d rv = _mm256_set1_pd(r);
+    __m256d far = _mm256_setzero_pd(); //lanes that have exceeded r
+    
+    for(int q = 0; q < dims; q++) {
+        double* p0 = d0 + q * stride;
+        double* p1 = d1 + q * stride;
+        for(int k = 0; k < l; k++) {
+            __m256d dist = _mm256_andnot_pd(sign, _mm256_sub_pd(_mm256_loadu_pd(p1 + k), _mm256_set1_pd(p0[k])));
+            far = _mm256_or_pd(far, _mm256_cmp_pd(dist, rv, _CMP_GT_OQ));
+            if(_mm256_movemask_pd(far) == 0xF) { //every candidate is too far away, no need to calculate further
+                *mask1 = 0;
+                return 0;
+            }
+        }
+    }
+    long mask0 = (~_mm256_movemask_pd(far)) & 0xF;
+    
+    for(int q = 0; q < dims; q++) {
+        __m256d dist = _mm256_andnot_pd(sign, _mm256_sub_pd(_mm256_loadu_pd(d1 + q * stride + l), _mm256_set1_pd(d0[q * stride + l])));
+        far = _mm256_or_pd(far, _mm256_cmp_pd(dist, rv, _CMP_GT_OQ));
+    }
+    *mask1 = (~_mm256_movemask_pd(far)) & 0xF;
+    
+    return mask0;
+}
+
+SC_UTIL_APEN_TARGET("avx2")
+long sc_util_apen_match_block_avx2(double* d0, double* d1, long l, long dims, long stride, double r, long* mask1) {
+    return sc_util_apen_match_block_avx2_body(d0, d1, l, dims, stride, r, mask1);
+}
+#endif
+
+//copies of the comparisons for pattern lengths 1 ... SC_UTIL_APEN_FIXED_MAX
+/* Each copy passes its length as a constant to the inlined body, so the element loops (the one extra element
+ for pattern_length + 1 included) are unrolled by the compiler and the window compared against stays in registers.
+ The l argument is ignored (it only keeps the signature of the generic comparison), callers get the right copy
+ from sc_util_apen_match_for and sc_util_apen_match_block_for.
+ */
+#define SC_UTIL_APEN_FIXED(L) \
+long sc_util_apen_match_##L(double* d0, double* d1, long l, long dims, long stride, long extend, double r) { \
+    (void)l; \
+    return sc_util_apen_match_body(d0, d1, L, dims, stride, extend, r); \
+} \
+long sc_util_apen_match_block_scalar_##L(double* d0, double* d1, long l, long dims, long stride, double r, long* mask1) { \
+    (void)l; \
+    return sc_util_apen_match_block_scalar_body(d0, d1, L, dims, stride, r, mask1); \
+}
+#define SC_UTIL_APEN_FIXED_X86(L) \
+SC_UTIL_APEN_TARGET("sse2") \
+long sc_util_apen_match_block_sse2_##L(double* d0, double* d1, long l, long dims, long stride, double r, long* mask1) { \
+    (void)l; \
+    return sc_util_apen_match_block_sse2_body(d0, d1, L, dims, stride, r, mask1); \
+} \
+SC_UTIL_APEN_TARGET("avx2") \
+long sc_util_apen_match_block_avx2_##L(double* d0, double* d1, long l, long dims, long stride, double r, long* mask1) { \
+    (void)l; \
+    return sc_util_apen_match_block_avx2_body(d0, d1, L, dims, stride, r, mask1); \
+}
+
+SC_UTIL_APEN_FIXED(1)
+SC_UTIL_APEN_FIXED(2)
+SC_UTIL_APEN_FIXED(3)
+SC_UTIL_APEN_FIXED(4)
+#ifdef SC_UTIL_APEN_X86
+SC_UTIL_APEN_FIXED_X86(1)
+SC_UTIL_APEN_FIXED_X86(2)
+SC_UTIL_APEN_FIXED_X86(3)
+SC_UTIL_APEN_FIXED_X86(4)
+#endif
+
+//the pair comparison for pattern length m, the copy for that length when there is one
+t_sc_util_apen_match sc_util_apen_match_for(long m) {
+    static const t_sc_util_apen_match fixed[SC_UTIL_APEN_FIXED_MAX + 1] = {NULL, sc_util_apen_match_1, sc_util_apen_match_2, sc_util_apen_match_3, sc_util_apen_match_4};
+    
+    if(m < 1 || m > SC_UTIL_APEN_FIXED_MAX) {
+        return sc_util_apen_match;
+    }
+    return fixed[m];
+}
+
+//the block comparison for pattern length m, the copy of sc_util_apen_match_block for that length when there is one
+t_sc_util_apen_match_block sc_util_apen_match_block_for(long m) {
+    static const t_sc_util_apen_match_block scalar[SC_UTIL_APEN_FIXED_MAX + 1] = {NULL, sc_util_apen_match_block_scalar_1, sc_util_apen_match_block_scalar_2, sc_util_apen_match_block_scalar_3, sc_util_apen_match_block_scalar_4};
+#ifdef SC_UTIL_APEN_X86
+    static const t_sc_util_apen_match_block sse2[SC_UTIL_APEN_FIXED_MAX + 1] = {NULL, sc_util_apen_match_block_sse2_1, sc_util_apen_match_block_sse2_2, sc_util_apen_match_block_sse2_3, sc_util_apen_match_block_sse2_4};
+    static const t_sc_util_apen_match_block avx2[SC_UTIL_APEN_FIXED_MAX + 1] = {NULL, sc_util_apen_match_block_avx2_1, sc_util_apen_match_block_avx2_2, sc_util_apen_match_block_avx2_3, sc_util_apen_match_block_avx2_4};
+#endif
+    
+    if(m < 1 || m > SC_UTIL_APEN_FIXED_MAX) {
+        return sc_util_apen_match_block;
+    }
+#ifdef SC_UTIL_APEN_X86
+    if(sc_util_apen_match_block == sc_util_apen_match_block_avx2) {
+        return avx2[m];
+    }
+    if(sc_util_apen_match_block == sc_util_apen_match_block_sse2) {
+        return sse2[m];
+    }
+#endif
+    if(sc_util_apen_match_block == sc_util_apen_match_block_scalar) {
+        return scalar[m];
+    }
+    return sc_util_apen_match_block;
+}
+
+//picks the block comparison for this cpu, falling back to the scalar version
+t_sc_util_apen_match_block sc_util_apen_select_match_block(void) {
+#ifdef SC_UTIL_APEN_X86
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    int max_leaf = info[0];
+    __cpuid(info, 1);
+    int has_sse2 = (info[3] >> 26) & 1;
+    int has_avx = ((info[2] >> 27) & 1) && ((info[2] >> 28) & 1) && ((_xgetbv(0) & 6) == 6); //cpu supports AVX and the os saves the registers
+    int has_avx2 = 0;
+    if(has_avx && max_leaf >= 7) {
+        __cpuidex(info, 7, 0);
+        has_avx2 = (info[1] >> 5) & 1;
+    }
+#else
+    __builtin_cpu_init();
+    int has_sse2 = __builtin_cpu_supports("sse2");
+    int has_avx2 = __builtin_cpu_supports("avx2");
+#endif
+    if(has_avx2) {
+        return sc_util_apen_match_block_avx2;
+    }
+    if(has_sse2) {
+        return sc_util_apen_match_block_sse2;
+    }
+#endif
+    return sc_util_apen_match_block_scalar;
+}
@@ -0,0 +1,91 @@
+/**
+	@file
+	sc.util.apen.kernel - template counting shared by sc.apen and sc.apen~, plain C without the Max SDK
+	Connor Rawls - cwrawls@asu.edu
+
+    Copyright Synthesis Center, Arizona State University, 2018
+
+	@ingroup    analysis-utilities
+*/
+
+#ifndef SC_UTIL_APEN_KERNEL_H
+#define SC_UTIL_APEN_KERNEL_H
+
+#include <stdlib.h>
+#include <math.h>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define SC_UTIL_APEN_X86 1
+#include <immintrin.h>                      // SSE2 / AVX2 template comparison
+#if defined(_MSC_VER)
+#include <intrin.h>                         // __cpuid for picking the comparison at runtime
+#endif
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define SC_UTIL_APEN_TARGET(t) __attribute__((target(t)))
+#define SC_UTIL_APEN_INLINE static inline __attribute__((always_inline))
+#elif defined(_MSC_VER)
+#define SC_UTIL_APEN_TARGET(t)
+#define SC_UTIL_APEN_INLINE static __forceinline
+#else
+#define SC_UTIL_APEN_TARGET(t)
+#define SC_UTIL_APEN_INLINE static inline
+#endif
+
+#define SC_UTIL_APEN_BLOCK 4                // number of candidate windows compared against one window at a time
+#define SC_UTIL_APEN_SORTED_MIN 256         // number of windows from which sorting by first element is tried before comparing every pair
+#define SC_UTIL_APEN_FIXED_MAX 4            // largest pattern_length with comparisons compiled for its length, see sc_util_apen_match_for
+#define SC_UTIL_APEN_HASH_DIMS 16           // number of vector dimensions sc_util_apen_count_hashed keeps a rolling hash for
+
+////////////////////////// slot of the hash table in sc_util_apen_count_hashed
+typedef struct _sc_util_apen_slot
+{
+    unsigned long long      hash;                       //hash of the window's values
+    long                    index;                      //first window with those values, -1 for an empty slot
+} t_sc_util_apen_slot;
+
+////////////////////////// sorting key for the neighbour search in sc_util_apen_count_sorted
+typedef struct _sc_util_apen_key
+{
+    double                  value;                      //first element of the window
+    long                    index;                      //index of the window in the series
+} t_sc_util_apen_key;
+
+size_t sc_util_apen_work_size(long length, long dims); //bytes of work memory the counting and FuzzyEn functions need
+double sc_util_apen_count_all(double* series, long length, long dims, long stride, long m, double r, long* c0, long* c1, void* work); //recompute every template match count from scratch, returns the number of pairs of windows compared
+double sc_util_apen_count_pairs(double* series, long length, long dims, long stride, long m, double r, long* c0, long* c1); //count matches by comparing every pair of windows
+double sc_util_apen_count_sorted(double* series, long length, long dims, long stride, long m, double r, long* c0, long* c1, void* work); //count matches by comparing only windows whose first elements are within similarity, returns -1 if it declined
+int sc_util_apen_key_compare(const void* a, const void* b); //qsort comparison for t_sc_util_apen_key
+double sc_util_apen_count_hashed(double* series, long length, long dims, long stride, long m, long* c0, long* c1, void* work); //count identical windows with a hash table, for whole numbers with r < 1, returns -1 if there is not enough memory
+long sc_util_apen_discrete(double* series, long length, long dims, long stride); //returns 1 if every value is a whole number, so windows within r < 1 are identical
+void sc_util_apen_count_sweep(double* series, long length, long dims, long stride, long m, double* r, long nr, long* c0, long* c1); //match counts for every similarity in r (sorted ascending) from one pass
+double sc_util_apen_from_counts(long length, long m, long* c0, long* c1); //turn the match counts into an ApEn value
+double sc_util_apen_sampen_from_counts(long length, long m, long* c0, long* c1); //turn the same match counts into a SampEn value
+void sc_util_apen_sampled(double* series, long length, long dims, long stride, long m, double r, long samples, unsigned long seed, double* result, double* ci, double* pairs, double* misses); //estimate ApEn and SampEn from samples reference windows
+double sc_util_apen_random(unsigned long* state); //uniform value in [0, 1) from a xorshift generator, repeatable from the seed
+double sc_util_apen_fuzzyen(double* series, long length, long dims, long stride, long m, double r, void* work); //calculate FuzzyEn with its own pass over the pairs of windows
+
+double sc_util_apen_maxdist(double* d0, double* d1, long l, double r); //get the maximum distance between pattern components
+long sc_util_apen_match(double* d0, double* d1, long l, long dims, long stride, long extend, double r); //decide pattern similarity at length l and, if extend is set, l + 1 in one pass
+
+//Compare one pair of windows, see sc_util_apen_match
+typedef long (*t_sc_util_apen_match)(double* d0, double* d1, long l, long dims, long stride, long extend, double r);
+
+//Compare one window against SC_UTIL_APEN_BLOCK neighbouring windows, see sc_util_apen_match_block_scalar
+typedef long (*t_sc_util_apen_match_block)(double* d0, double* d1, long l, long dims, long stride, double r, long* mask1);
+long sc_util_apen_match_block_scalar(double* d0, double* d1, long l, long dims, long stride, double r, long* mask1);
+#ifdef SC_UTIL_APEN_X86
+long sc_util_apen_match_block_sse2(double* d0, double* d1, long l, long dims, long stride, double r, long* mask1);
+long sc_util_apen_match_block_avx2(double* d0, double* d1, long l, long dims, long stride, double r, long* mask1);
+#endif
+t_sc_util_apen_match_block sc_util_apen_select_match_block(void); //pick the fastest comparison the cpu supports
+
+//comparisons compiled for a fixed pattern length, chosen once for each pattern_length
+t_sc_util_apen_match sc_util_apen_match_for(long m); //sc_util_apen_match for pattern length m
+t_sc_util_apen_match_block sc_util_apen_match_block_for(long m); //sc_util_apen_match_block for pattern length m
+
+//block comparison used by every object, chosen once when the class is created
+extern t_sc_util_apen_match_block sc_util_apen_match_block;
+
+#endif
@@ -0,0 +1,168 @@
+/**
+	@file
+	sc.util.apen.test - checks the SIMD and specialised template comparisons against the scalar one
+	Connor Rawls - cwrawls@asu.edu
+
+    Copyright Synthesis Center, Arizona State University, 2018
+
+	@ingroup    analysis-utilities
+*/
+
+/* usage: sc_apen_test
+
+ Every block comparison the cpu supports (SSE2, AVX2, and the copies for pattern lengths 1 to SC_UTIL_APEN_FIXED_MAX)
+ must give exactly the masks of the scalar comparison, for vectors of 1 to 3 dimensions stored one plane after the other.
+ The match counts of sc_util_apen_count_pairs with each of them, and of sc_util_apen_count_all (which may sort or hash
+ instead), must equal those of the scalar comparison for series lengths that leave windows past the last full block.
+ The values are multiples of 0.25 so that distances equal to r, where > and >= differ, are common.
+ Prints every failing case and exits with status 1 if there was one.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "sc.util.apen.core.h"
+
+#define SC_UTIL_APEN_TEST_MAX_M 6           // longest pattern_length tested, past the fixed-length copies
+#define SC_UTIL_APEN_TEST_PAD 8             // values after each plane, so blocks at the end of the series stay readable
+
+////////////////////////// one block comparison under test
+typedef struct _sc_util_apen_test_kernel
+{
+    const char*             name;                       //printed with failures
+    t_sc_util_apen_match_block global;                  //value of sc_util_apen_match_block selecting it
+} t_sc_util_apen_test_kernel;
+
+void sc_util_apen_test_series(double* d, long length, long dims, long stride, unsigned long seed); //fills dims planes of length values with multiples of 0.25
+long sc_util_apen_test_blocks(const t_sc_util_apen_test_kernel* kernel, double* d, long length, long dims, long stride, long m, double r); //returns the number of blocks whose masks differ from the scalar ones
+long sc_util_apen_test_counts(const t_sc_util_apen_test_kernel* kernel, double* d, long length, long dims, long stride, long m, double r); //returns the number of windows whose counts differ from the scalar ones
+
+void sc_util_apen_test_series(double* d, long length, long dims, long stride, unsigned long seed) {
+    unsigned long state = seed;
+
+    for(long k = 0; k < dims; k++) {
+        for(long t = 0; t < stride; t++) {
+            d[k * stride + t] = (t < length) ? floor(sc_util_apen_random(&state) * 9.0) * 0.25 - 1.0 : 0.0;
+        }
+    }
+}
+
+//compares each window with the block after it, through the generic kernel and the copy for m
+long sc_util_apen_test_blocks(const t_sc_util_apen_test_kernel* kernel, double* d, long length, long dims, long stride, long m, double r) {
+    long failed = 0;
+
+    sc_util_apen_match_block = kernel->global;
+    t_sc_util_apen_match_block fixed = sc_util_apen_match_block_for(m);
+
+    for(long i = 0; i + m < length; i++) {
+        for(long j = 0; j + m < length; j++) {
+            long scalar1 = 0;
+            long simd1 = 0;
+            long fixed1 = 0;
+            long scalar0 = sc_util_apen_match_block_scalar(d + i, d + j, m, dims, stride, r, &scalar1);
+            long simd0 = kernel->global(d + i, d + j, m, dims, stride, r, &simd1);
+            long fixed0 = fixed(d + i, d + j, m, dims, stride, r, &fixed1);
+            if(simd0 != scalar0 || simd1 != scalar1 || fixed0 != scalar0 || fixed1 != scalar1) {
+                if(!failed) {
+                    printf("%-6s blocks dims %ld length %ld m %ld r %.2f: window %ld against %ld, masks %lx/%lx and %lx/%lx instead of %lx/%lx\n", kernel->name, dims, length, m, r, i, j, simd0, simd1, fixed0, fixed1, scalar0, scalar1);
+                }
+                failed++;
+            }
+        }
+    }
+    return failed;
+}
+
+long sc_util_apen_test_counts(const t_sc_util_apen_test_kernel* kernel, double* d, long length, long dims, long stride, long m, double r) {
+    long n0 = length - m + 1;
+    long* c0 = (long*)malloc(sizeof(long) * n0 * 6);
+    long* c1 = c0 + n0;
+    long* s0 = c0 + 2 * n0;
+    long* s1 = c0 + 3 * n0;
+    long* a0 = c0 + 4 * n0;
+    long* a1 = c0 + 5 * n0;
+    void* work = malloc(sc_util_apen_work_size(length, dims));
+    long failed = 0;
+
+    if(!c0 || !work) {
+        printf("could not allocate the counts for length %ld\n", length);
+        free(c0);
+        free(work);
+        return 1;
+    }
+
+    sc_util_apen_match_block = sc_util_apen_match_block_scalar;
+    sc_util_apen_count_pairs(d, length, dims, stride, m, r, s0, s1);
+    sc_util_apen_match_block = kernel->global;
+    sc_util_apen_count_pairs(d, length, dims, stride, m, r, c0, c1);
+    sc_util_apen_count_all(d, length, dims, stride, m, r, a0, a1, work);
+
+    for(long i = 0; i < n0; i++) {
+        long last = (i == n0 - 1); //no window of size m + 1 starts at the last window
+        if(c0[i] != s0[i] || (!last && c1[i] != s1[i]) || a0[i] != s0[i] || (!last && a1[i] != s1[i])) {
+            if(!failed) {
+                printf("%-6s counts dims %ld length %ld m %ld r %.2f: window %ld has %ld/%ld and %ld/%ld instead of %ld/%ld\n", kernel->name, dims, length, m, r, i, c0[i], last ? 0 : c1[i], a0[i], last ? 0 : a1[i], s0[i], last ? 0 : s1[i]);
+            }
+            failed++;
+        }
+    }
+    free(c0);
+    free(work);
+    return failed;
+}
+
+int main(void) {
+    t_sc_util_apen_test_kernel kernels[3];
+    long nkernels = 0;
+    long lengths[] = {5, 7, 13, 31, 129, 301};
+    double similarities[] = {0.0, 0.25, 0.5};
+    long cases = 0;
+    long failed = 0;
+
+    kernels[nkernels].name = "scalar";
+    kernels[nkernels++].global = sc_util_apen_match_block_scalar;
+#ifdef SC_UTIL_APEN_X86
+    //only the comparisons this cpu can run
+    t_sc_util_apen_match_block fastest = sc_util_apen_select_match_block();
+    if(fastest != sc_util_apen_match_block_scalar) {
+        kernels[nkernels].name = "sse2";
+        kernels[nkernels++].global = sc_util_apen_match_block_sse2;
+    }
+    if(fastest == sc_util_apen_match_block_avx2) {
+        kernels[nkernels].name = "avx2";
+        kernels[nkernels++].global = sc_util_apen_match_block_avx2;
+    }
+#endif
+
+    for(long dims = 1; dims <= 3; dims++) {
+        for(unsigned long li = 0; li < sizeof(lengths) / sizeof(lengths[0]); li++) {
+            long length = lengths[li];
+            long stride = length + SC_UTIL_APEN_TEST_PAD;
+            double* d = (double*)malloc(sizeof(double) * stride * dims);
+            if(!d) {
+                printf("could not allocate a series of length %ld\n", length);
+                return 1;
+            }
+            sc_util_apen_test_series(d, length, dims, stride, (unsigned long)(dims * 1000 + length));
+
+            for(long m = 1; m <= SC_UTIL_APEN_TEST_MAX_M && m * 2 <= length; m++) {
+                for(unsigned long ri = 0; ri < sizeof(similarities) / sizeof(similarities[0]); ri++) {
+                    for(long k = 0; k < nkernels; k++) {
+                        long bad = sc_util_apen_test_blocks(&kernels[k], d, length, dims, stride, m, similarities[ri]);
+                        bad += sc_util_apen_test_counts(&kernels[k], d, length, dims, stride, m, similarities[ri]);
+                        failed += (bad > 0);
+                        cases++;
+                    }
+                }
+            }
+            free(d);
+        }
+    }
+
+    printf("%ld of %ld cases failed, kernels tested:", failed, cases);
+    for(long k = 0; k < nkernels; k++) {
+        printf(" %s", kernels[k].name);
+    }
+    printf("\n");
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,592 @@
+/**
+	@file
+	sc.apen~ - an object to compute the approximate entropy of a signal
+	Connor Rawls - cwrawls@asu.edu
+
+    Copyright Synthesis Center, Arizona State University, 2018
+
+	@ingroup    analysis-utilities
+*/
+
+#include "ext.h"							// standard Max include, always required
+#include "ext_obex.h"						// required for new style Max object
+#include "z_dsp.h"							// required for MSP objects
+
+#include "sc.util.apen.core.h"             // series storage and calculation shared with sc.apen
+
+////////////////////////// object struct
+typedef struct _sc_util_apen_tilde
+{
+	t_pxobject	            ob;
+    t_sc_util_apen_core     core;                       //the signal and the parameters of the calculation, see sc.util.apen.core.h. Counts are only made by the worker, never on the audio thread
+    double                  interval;                   //time in ms between calculations while new samples arrive
+    long                    samples_since_calc;         //number of samples received since the last calculation was requested
+    double                  apen;                       //latest ApEn value, held on the signal outlet
+    t_critical              lock;                       //guards core and apen between the audio thread, the worker and the main thread
+    void*                   calc_clock;                 //requests a calculation every interval ms
+    t_systhread             worker;                     //thread running sc_util_apen_tilde_worker
+    t_systhread_mutex       worker_mutex;               //guards the worker_ fields shared with the worker thread
+    t_systhread_cond        worker_cond;                //signalled when a calculation is requested or the worker should quit
+    long                    worker_pending;             //flag set when a calculation has been requested, requests made while one is running are merged
+    long                    worker_quit;                //flag telling the worker thread to exit
+    void*                   worker_qelem;               //outputs the latest ApEn value from the main thread
+    double*                 worker_series;              //the worker's snapshot of the series, only touched by the worker thread
+    long*                   worker_count0;              //the worker's match counts for pattern_length
+    long*                   worker_count1;              //the worker's match counts for pattern_length + 1
+    long                    worker_capacity;            //number of values worker_series and the worker counts can hold
+    void*                   worker_work;                //the worker's memory for the counting kernels, sc_util_apen_work_size(worker_capacity, 1) bytes
+	void*                   out;                        //float outlet for ApEn
+    void*                   out2;                       //signal outlet for ApEn
+} t_sc_util_apen_tilde;
+
+
+///////////////////////// function prototypes
+//// standard set
+void *sc_util_apen_tilde_new(t_symbol *s, long argc, t_atom *argv);
+void sc_util_apen_tilde_free(t_sc_util_apen_tilde *x);
+void sc_util_apen_tilde_assist(t_sc_util_apen_tilde *x, void *b, long m, long a, char *s);
+
+//// MSP
+void sc_util_apen_tilde_dsp64(t_sc_util_apen_tilde *x, t_object *dsp64, short *count, double samplerate, long maxvectorsize, long flags);
+void sc_util_apen_tilde_perform64(t_sc_util_apen_tilde *x, t_object *dsp64, double **ins, long numins, double **outs, long numouts, long sampleframes, long flags, void *userparam); //writes the input block into the series and holds the latest ApEn on the output
+
+//// Messages
+void sc_util_apen_tilde_bang(t_sc_util_apen_tilde *x);                                  //requests a calculation if enough data is available
+void sc_util_apen_tilde_clear(t_sc_util_apen_tilde *x);                                 //empties the series
+void sc_util_apen_tilde_set_series_length(t_sc_util_apen_tilde *x, void *attr, long argc, t_atom *argv);     //sets the maximum length of the series
+void sc_util_apen_tilde_pattern_length(t_sc_util_apen_tilde *x, void *attr, long argc, t_atom *argv);        //sets the size of the pattern to be computed
+void sc_util_apen_tilde_similarity(t_sc_util_apen_tilde *x, void *attr, long argc, t_atom *argv);           //sets the threshold for pattern similarity
+void sc_util_apen_tilde_set_interval(t_sc_util_apen_tilde *x, void *attr, long argc, t_atom *argv);         //sets the time between calculations
+
+void sc_util_apen_tilde_get_series_length(t_sc_util_apen_tilde *x, t_object *attr, long *argc, t_atom **argv);
+void sc_util_apen_tilde_get_cur_size(t_sc_util_apen_tilde *x, t_object *attr, long *argc, t_atom **argv);
+void sc_util_apen_tilde_set_cur_size(t_sc_util_apen_tilde *x, t_object *attr, long *argc, t_atom **argv);   //dummy function to prevent attribute being set
+void sc_util_apen_tilde_get_pattern_length(t_sc_util_apen_tilde *x, t_object *attr, long *argc, t_atom **argv);
+void sc_util_apen_tilde_get_similarity(t_sc_util_apen_tilde *x, t_object *attr, long *argc, t_atom **argv);
+void sc_util_apen_tilde_get_interval(t_sc_util_apen_tilde *x, t_object *attr, long *argc, t_atom **argv);
+
+void sc_util_apen_tilde_tick(t_sc_util_apen_tilde *x); //clock function, requests a calculation if samples arrived since the last one
+
+//Worker thread, ApEn is never calculated on the audio thread
+void sc_util_apen_tilde_request(t_sc_util_apen_tilde *x); //ask the worker for a calculation, merged with any request not yet started
+void *sc_util_apen_tilde_worker(t_sc_util_apen_tilde *x); //thread function, calculates ApEn on a snapshot of the series whenever requested
+long sc_util_apen_tilde_worker_alloc(t_sc_util_apen_tilde *x, long max); //sizes the worker's snapshot for max samples, returns 0 if there is not enough memory
+void sc_util_apen_tilde_worker_output(t_sc_util_apen_tilde *x); //qelem function, outputs the latest ApEn value from the main thread
+void sc_util_apen_tilde_worker_stop(t_sc_util_apen_tilde *x); //ends the worker thread and frees its memory
+
+//////////////////////// global class pointer variable
+void *sc_util_apen_tilde_class;
+
+
+void ext_main(void *r)
+{
+	t_class *c;
+
+	c = class_new("sc.apen~", (method)sc_util_apen_tilde_new, (method)sc_util_apen_tilde_free, (long)sizeof(t_sc_util_apen_tilde),
+				  0L /* leave NULL!! */, A_GIMME, 0);
+
+	class_addmethod(c, (method)sc_util_apen_tilde_dsp64,		"dsp64",                A_CANT,     0);
+	class_addmethod(c, (method)sc_util_apen_tilde_bang,         "bang",                             0);
+    class_addmethod(c, (method)sc_util_apen_tilde_clear,        "clear",                            0);
+
+    //Symbol versions of attributes we want to be callable from the patcher
+    CLASS_ATTR_LONG(c, "series_length",          0,                      t_sc_util_apen_tilde, core.series_max_length);
+    CLASS_ATTR_ACCESSORS(c, "series_length", sc_util_apen_tilde_get_series_length, sc_util_apen_tilde_set_series_length);
+
+    CLASS_ATTR_LONG(c, "current_size",           ATTR_SET_OPAQUE,        t_sc_util_apen_tilde, core.series_length);
+    CLASS_ATTR_ACCESSORS(c, "current_size", sc_util_apen_tilde_get_cur_size, sc_util_apen_tilde_set_cur_size);
+
+    CLASS_ATTR_LONG(c, "pattern_length",         0,                      t_sc_util_apen_tilde, core.pattern_length);
+    CLASS_ATTR_ACCESSORS(c, "pattern_length", sc_util_apen_tilde_get_pattern_length, sc_util_apen_tilde_pattern_length);
+
+    CLASS_ATTR_DOUBLE(c, "similarity",           0,                      t_sc_util_apen_tilde, core.similarity_factor);
+    CLASS_ATTR_ACCESSORS(c, "similarity", sc_util_apen_tilde_get_similarity, sc_util_apen_tilde_similarity);
+
+    CLASS_ATTR_DOUBLE(c, "interval",             0,                      t_sc_util_apen_tilde, interval);
+    CLASS_ATTR_ACCESSORS(c, "interval", sc_util_apen_tilde_get_interval, sc_util_apen_tilde_set_interval);
+
+	/* you CAN'T call this from the patcher */
+	class_addmethod(c, (method)sc_util_apen_tilde_assist,		"assist",		A_CANT, 0);
+
+	class_dspinit(c);
+	class_register(CLASS_BOX, c);
+	sc_util_apen_tilde_class = c;
+
+    sc_util_apen_match_block = sc_util_apen_select_match_block();
+}
+
+/////function definitions
+
+void sc_util_apen_tilde_assist(t_sc_util_apen_tilde *x, void *b, long m, long a, char *s)
+{
+	if (m == ASSIST_INLET) { //inlet
+        sprintf(s, "Inlet %ld: (signal) Input to ApEn series / messages in", a);
+	}
+	else {	// outlet
+        if(a == 0) {
+            sprintf(s, "Outlet %ld: (signal) Approximate Entropy", a);
+        } else {
+            sprintf(s, "Outlet %ld: Approximate Entropy every interval ms", a);
+        }
+	}
+}
+
+void sc_util_apen_tilde_free(t_sc_util_apen_tilde *x)
+{
+    dsp_free((t_pxobject *)x);
+
+    if(x->calc_clock) {
+        clock_unset(x->calc_clock);
+        object_free(x->calc_clock);
+        x->calc_clock = NULL;
+    }
+    sc_util_apen_tilde_worker_stop(x);
+
+    sc_util_apen_core_free(&x->core);
+    critical_free(x->lock);
+}
+
+void *sc_util_apen_tilde_new(t_symbol *s, long argc, t_atom *argv)
+{
+	t_sc_util_apen_tilde *x = NULL;
+
+	if ((x = (t_sc_util_apen_tilde *)object_alloc(sc_util_apen_tilde_class))) {
+        //Set initial values
+        x->interval = 100.0;
+        x->samples_since_calc = 0;
+        x->apen = 0.0;
+        critical_new(&x->lock);
+
+        dsp_setup((t_pxobject *)x, 1);
+        x->out = outlet_new(x, "float");
+        x->out2 = outlet_new(x, "signal");
+
+        //allocate memory for the initial data series, 1024 samples with pattern_length 3 and similarity 1.0
+        if(!sc_util_apen_core_init(&x->core, 1024, 1)) {
+            object_error((t_object *)x, "could not allocate the series");
+        }
+        //the audio thread only stores samples, the worker counts its own copy of the series
+        sc_util_apen_core_set_incremental(&x->core, 0);
+
+        //the worker runs for the lifetime of the object, it sleeps until a calculation is requested
+        x->worker = NULL;
+        x->worker_pending = 0;
+        x->worker_quit = 0;
+        x->worker_series = NULL;
+        x->worker_count0 = NULL;
+        x->worker_count1 = NULL;
+        x->worker_capacity = 0;
+        x->worker_work = NULL;
+        systhread_mutex_new(&x->worker_mutex, 0);
+        systhread_cond_new(&x->worker_cond, 0);
+        x->worker_qelem = qelem_new(x, (method)sc_util_apen_tilde_worker_output);
+        if(systhread_create((method)sc_util_apen_tilde_worker, x, 0, 0, 0, &x->worker)) {
+            x->worker = NULL;
+            object_error((t_object *)x, "could not start the worker thread, ApEn will not be calculated");
+        }
+
+        //process arguments typed into object box
+        attr_args_process(x, argc, argv);
+
+        x->calc_clock = clock_new(x, (method)sc_util_apen_tilde_tick);
+        clock_fdelay(x->calc_clock, x->interval);
+
+    } else {
+        poststring("Failed to create new ApEn~");
+    }
+
+	return (x);
+}
+
+void sc_util_apen_tilde_dsp64(t_sc_util_apen_tilde *x, t_object *dsp64, short *count, double samplerate, long maxvectorsize, long flags)
+{
+	object_method(dsp64, gensym("dsp_add64"), x, sc_util_apen_tilde_perform64, 0, NULL);
+}
+
+//writes the input block into the series and holds the latest ApEn on the output
+/* The block goes straight into the core's mirrored ring, so the series is always contiguous for the worker's copy.
+ The core does not keep match counts for sc.apen~ (incremental is off), so storing a sample is O(1).
+ No atoms are made and nothing is calculated here, the audio thread only waits while the worker copies the series.
+ */
+void sc_util_apen_tilde_perform64(t_sc_util_apen_tilde *x, t_object *dsp64, double **ins, long numins, double **outs, long numouts, long sampleframes, long flags, void *userparam)
+{
+	t_double *in = ins[0];
+	t_double *out = outs[0];
+    long n = sampleframes;
+
+    critical_enter(x->lock);
+
+    long max = x->core.series_max_length;
+
+    //only the last series_max_length samples of a long block can stay in the series
+    if(n > max) {
+        in += n - max;
+        n = max;
+    }
+
+    if(x->core.test_value) {
+        sc_util_apen_core_append_list(&x->core, in, n);
+    }
+    x->samples_since_calc += sampleframes;
+    double apen = x->apen;
+
+    critical_exit(x->lock);
+
+    for(long i = 0; i < sampleframes; i++) {
+        out[i] = apen;
+    }
+}
+
+//requests a calculation if enough data is available
+void sc_util_apen_tilde_bang(t_sc_util_apen_tilde *x)
+{
+    //the audio thread changes series_length, check it under the lock
+    critical_enter(x->lock);
+    long length = x->core.series_length;
+    long needed = x->core.pattern_length * 2;
+    if(length >= needed) {
+        x->samples_since_calc = 0;
+    }
+    critical_exit(x->lock);
+
+    if(length < needed) {
+        object_warn((t_object*)x, "Not enough data to calculate approximate entropy.");
+        object_warn((t_object*)x, "Need %ld samples, have %ld", needed, length);
+        return;
+    }
+
+    sc_util_apen_tilde_request(x);
+}
+
+//requests a calculation if samples arrived since the last one, then waits for the next interval
+void sc_util_apen_tilde_tick(t_sc_util_apen_tilde *x)
+{
+    critical_enter(x->lock);
+    long ready = x->samples_since_calc > 0 && x->core.series_length >= x->core.pattern_length * 2;
+    if(ready) {
+        x->samples_since_calc = 0;
+    }
+    critical_exit(x->lock);
+
+    if(ready) {
+        sc_util_apen_tilde_request(x);
+    }
+    clock_fdelay(x->calc_clock, x->interval);
+}
+
+//asks the worker thread for a calculation
+/* The worker takes its snapshot of the series when it starts a calculation, so any number of requests made
+ while a calculation is running collapse into a single new calculation on the latest samples.
+ */
+void sc_util_apen_tilde_request(t_sc_util_apen_tilde *x) {
+    systhread_mutex_lock(x->worker_mutex);
+    x->worker_pending = 1;
+    systhread_cond_signal(x->worker_cond);
+    systhread_mutex_unlock(x->worker_mutex);
+}
+
+void *sc_util_apen_tilde_worker(t_sc_util_apen_tilde *x) {
+    while(1) {
+        systhread_mutex_lock(x->worker_mutex);
+        while(!x->worker_pending && !x->worker_quit) {
+            systhread_cond_wait(x->worker_cond, x->worker_mutex);
+        }
+        if(x->worker_quit) {
+            systhread_mutex_unlock(x->worker_mutex);
+            break;
+        }
+        x->worker_pending = 0;
+        systhread_mutex_unlock(x->worker_mutex);
+
+        //grow the snapshot to the series first, the worker_ arrays belong to this thread so the audio thread never waits for the allocator
+        critical_enter(x->lock);
+        long max = x->core.series_max_length;
+        critical_exit(x->lock);
+        if(x->worker_capacity < max && !sc_util_apen_tilde_worker_alloc(x, max)) {
+            object_error((t_object *)x, "could not allocate memory for a series of length %ld, ApEn was not calculated", max);
+            continue;
+        }
+
+        //snapshot the series and parameters, the audio thread only waits for the copy
+        critical_enter(x->lock);
+        if(x->worker_capacity < x->core.series_max_length) {
+            //series_length grew while the snapshot was allocated, start over at the new size
+            critical_exit(x->lock);
+            sc_util_apen_tilde_request(x);
+            continue;
+        }
+        long length = x->core.series_length;
+        long m = x->core.pattern_length;
+        double r = x->core.similarity;
+        long version = x->core.version;
+        double result[3];
+
+        //no samples since the last calculation (dsp off), output it again without a snapshot
+        if(length >= m * 2 && sc_util_apen_core_cached(&x->core, SC_UTIL_APEN_MODE_APEN, 1, result)) {
+            x->apen = result[0];
+            critical_exit(x->lock);
+            qelem_set(x->worker_qelem);
+            continue;
+        }
+        sc_util_apen_core_copy(&x->core, x->worker_series);
+        critical_exit(x->lock);
+
+        if(length < m * 2) {
+            continue;
+        }
+
+        //same calculation as sc.apen, a single dimension
+        t_sc_util_apen_stats stats = {0, 0, 0};
+        sc_util_apen_estimate(x->worker_series, length, 1, length, m, r, SC_UTIL_APEN_MODE_APEN, x->worker_count0, x->worker_count1, 0, result, x->worker_work, &stats, NULL);
+
+        critical_enter(x->lock);
+        x->apen = result[0];
+        x->core.stats.comparisons += stats.comparisons;
+        x->core.stats.rejections += stats.rejections;
+        sc_util_apen_core_store(&x->core, version, SC_UTIL_APEN_MODE_APEN, 1, result, NULL);
+        critical_exit(x->lock);
+
+        qelem_set(x->worker_qelem);
+    }
+
+    systhread_exit(0);
+    return NULL;
+}
+
+void sc_util_apen_tilde_worker_output(t_sc_util_apen_tilde *x) {
+    critical_enter(x->lock);
+    double apen = x->apen;
+    critical_exit(x->lock);
+
+    outlet_float(x->out, apen);
+}
+
+//replaces the worker's snapshot buffers with buffers for a series of max samples, called by the worker without lock
+/* If any of them cannot be allocated none are kept and capacity goes to 0, the next request tries again. */
+long sc_util_apen_tilde_worker_alloc(t_sc_util_apen_tilde *x, long max) {
+    if(x->worker_capacity) {
+        sysmem_freeptr(x->worker_series);
+        sysmem_freeptr(x->worker_count0);
+        sysmem_freeptr(x->worker_count1);
+        sysmem_freeptr(x->worker_work);
+    }
+    x->worker_series = (double*)sysmem_newptr(sizeof(double) * max);
+    x->worker_count0 = (long*)sysmem_newptr(sizeof(long) * max);
+    x->worker_count1 = (long*)sysmem_newptr(sizeof(long) * max);
+    x->worker_work = sysmem_newptr(sc_util_apen_work_size(max, 1));
+    if(x->worker_series && x->worker_count0 && x->worker_count1 && x->worker_work) {
+        x->worker_capacity = max;
+        return 1;
+    }
+
+    if(x->worker_series) {
+        sysmem_freeptr(x->worker_series);
+    }
+    if(x->worker_count0) {
+        sysmem_freeptr(x->worker_count0);
+    }
+    if(x->worker_count1) {
+        sysmem_freeptr(x->worker_count1);
+    }
+    if(x->worker_work) {
+        sysmem_freeptr(x->worker_work);
+    }
+    x->worker_series = NULL;
+    x->worker_count0 = NULL;
+    x->worker_count1 = NULL;
+    x->worker_work = NULL;
+    x->worker_capacity = 0;
+    return 0;
+}
+
+void sc_util_apen_tilde_worker_stop(t_sc_util_apen_tilde *x) {
+    if(x->worker) {
+        unsigned int ret;
+
+        systhread_mutex_lock(x->worker_mutex);
+        x->worker_quit = 1;
+        systhread_cond_signal(x->worker_cond);
+        systhread_mutex_unlock(x->worker_mutex);
+
+        systhread_join(x->worker, &ret);
+        x->worker = NULL;
+    }
+
+    if(x->worker_qelem) {
+        qelem_free(x->worker_qelem);
+        x->worker_qelem = NULL;
+    }
+    if(x->worker_mutex) {
+        systhread_mutex_free(x->worker_mutex);
+        x->worker_mutex = NULL;
+    }
+    if(x->worker_cond) {
+        systhread_cond_free(x->worker_cond);
+        x->worker_cond = NULL;
+    }
+
+    if(x->worker_capacity) {
+        sysmem_freeptr(x->worker_series);
+        sysmem_freeptr(x->worker_count0);
+        sysmem_freeptr(x->worker_count1);
+        sysmem_freeptr(x->worker_work);
+    }
+    x->worker_series = NULL;
+    x->worker_count0 = NULL;
+    x->worker_count1 = NULL;
+    x->worker_work = NULL;
+    x->worker_capacity = 0;
+}
+
+//empties the series
+void sc_util_apen_tilde_clear(t_sc_util_apen_tilde *x){
+
+    critical_enter(x->lock);
+
+    sc_util_apen_core_clear(&x->core);
+    x->samples_since_calc = 0;
+    x->apen = 0.0;
+
+    critical_exit(x->lock);
+}
+
+//sets the maximum length of the series
+void sc_util_apen_tilde_set_series_length(t_sc_util_apen_tilde *x, void *attr, long argc, t_atom *argv){
+    if(argc && argv) {
+
+        long temp_sl = 0;
+
+        switch(atom_gettype(argv)){
+            case A_LONG:
+                temp_sl = atom_getlong(argv);
+                break;
+            case A_FLOAT:
+                temp_sl = (long)atom_getfloat(argv);
+                break;
+            default:
+                object_error((t_object *)x, "bad value for series_length");
+                return;
+                break;
+        }
+
+        if(temp_sl > ((2 * x->core.pattern_length) + 1) && temp_sl != x->core.series_max_length) {
+            //the most recent samples are kept, the old series stays as it was if there is not enough memory
+            critical_enter(x->lock);
+            long ok = sc_util_apen_core_set_max_length(&x->core, temp_sl);
+            critical_exit(x->lock);
+
+            if(!ok) {
+                object_error((t_object *)x, "could not allocate a series of length %ld", temp_sl);
+            }
+        } else if(temp_sl != x->core.series_max_length){
+            object_error((t_object *)x, "Series length too short, must >= %ld", (2 * x->core.pattern_length) + 1);
+        }
+    }
+}
+
+void sc_util_apen_tilde_get_series_length(t_sc_util_apen_tilde *x, t_object *attr, long *argc, t_atom **argv){
+    char alloc;
+    long sl = 0;
+
+    atom_alloc(argc, argv, &alloc);
+    sl = x->core.series_max_length;
+    atom_setlong(*argv, sl);
+}
+
+void sc_util_apen_tilde_get_cur_size(t_sc_util_apen_tilde *x, t_object *attr, long *argc, t_atom **argv){
+    char alloc;
+    long cs = 0;
+
+    atom_alloc(argc, argv, &alloc);
+    cs = x->core.series_length;
+    atom_setlong(*argv, cs);
+}
+
+void sc_util_apen_tilde_set_cur_size(t_sc_util_apen_tilde *x, t_object *attr, long *argc, t_atom **argv) {
+
+}
+
+//sets the size of the pattern to be computed
+void sc_util_apen_tilde_pattern_length(t_sc_util_apen_tilde *x, void *attr, long argc, t_atom *argv){
+    if(argc && argv) {
+        long temp_pl = 0;
+
+        switch(atom_gettype(argv)){
+            case A_LONG:
+                temp_pl = atom_getlong(argv);
+                break;
+            case A_FLOAT:
+                temp_pl = (long)atom_getfloat(argv);
+                break;
+            default:
+                object_error((t_object *)x, "bad value received for pattern_length");
+                return;
+                break;
+        }
+
+        if(temp_pl <= (x->core.series_max_length / 2) - 1 && temp_pl > 1){
+            critical_enter(x->lock);
+            sc_util_apen_core_set_pattern_length(&x->core, temp_pl);
+            critical_exit(x->lock);
+        } else if(temp_pl > (x->core.series_max_length / 2) - 1){
+            object_error((t_object *)x, "pattern_length must be <= %ld", (x->core.series_max_length / 2) - 1);
+        } else {
+            object_error((t_object *)x, "pattern_length must be an integer > 1");
+        }
+    }
+}
+
+void sc_util_apen_tilde_get_pattern_length(t_sc_util_apen_tilde *x, t_object *attr, long *argc, t_atom **argv){
+    char alloc;
+    long pl = 0;
+
+    atom_alloc(argc, argv, &alloc);
+    pl = x->core.pattern_length;
+    atom_setlong(*argv, pl);
+}
+
+//sets the threshold for pattern similarity
+void sc_util_apen_tilde_similarity(t_sc_util_apen_tilde *x, void *attr, long argc, t_atom *argv){
+    if(argv && argc) {
+        double temp_sim = atom_getfloat(argv);
+
+        if(temp_sim > 0.0) {
+            critical_enter(x->lock);
+            sc_util_apen_core_set_similarity(&x->core, temp_sim);
+            critical_exit(x->lock);
+        } else {
+            object_error((t_object *)x, "Similarity must be > 0.0, received %f", temp_sim);
+        }
+    }
+}
+
+void sc_util_apen_tilde_get_similarity(t_sc_util_apen_tilde *x, t_object *attr, long *argc, t_atom **argv){
+    char alloc;
+    double sim = 0.0;
+
+    atom_alloc(argc, argv, &alloc);
+    sim = x->core.similarity_factor;
+    atom_setfloat(*argv, sim);
+}
+
+//sets the time in ms between calculations
+void sc_util_apen_tilde_set_interval(t_sc_util_apen_tilde *x, void *attr, long argc, t_atom *argv){
+    if(argc && argv) {
+        double temp_int = atom_getfloat(argv);
+
+        if(temp_int >= 1.0) {
+            x->interval = temp_int;
+        } else {
+            object_error((t_object *)x, "interval must be >= 1.0, received %f", temp_int);
+        }
+    }
+}
+
+void sc_util_apen_tilde_get_interval(t_sc_util_apen_tilde *x, t_object *attr, long *argc, t_atom **argv){
+    char alloc;
+    double in = 0.0;
+
+    atom_alloc(argc, argv, &alloc);
+    in = x->interval;
+    atom_setfloat(*argv, in);
+}